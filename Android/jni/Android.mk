@@ -14,18 +14,129 @@ LOCAL_SRC_FILES			:= 	../../../FrontendGo/OvrApp.cpp \
 							../../../FrontendGo/FontMaster.cpp \
 							../../../FrontendGo/MenuHelper.cpp \
 							../../../FrontendGo/Menu.cpp \
-							../../Src/Emulator.cpp
+							../../Src/Emulator.cpp \
+							../../Src/PerformanceGovernor.cpp \
+							../../Src/ResumeSnapshot.cpp \
+							../../Src/FlightRecorder.cpp \
+							../../Src/Netplay.cpp \
+							../../Src/EmulatorContext.cpp \
+							../../Src/MemorySearch.cpp \
+							../../Src/Cheats.cpp \
+							../../Src/Capture.cpp \
+							../../Src/FrameExport.cpp \
+							../../Src/RomArchive.cpp \
+							../../Src/RomCache.cpp \
+							../../Src/BufferPool.cpp \
+							../../Src/MemoryTracker.cpp \
+							../../Src/RemoteLibrary.cpp \
+							../../Src/CoverCache.cpp \
+							../../Src/RunState.cpp \
+							../../Src/RomPatch.cpp \
+							../../Src/Preloader.cpp \
+							../../Src/FrameScheduler.cpp \
+							../../Src/StateFile.cpp \
+							../../Src/ProgramCache.cpp
 							
 LOCAL_STATIC_LIBRARIES	:= vrsound vrmodel vrlocale vrgui vrappframework libovrkernel freetype vbEmulator
 LOCAL_SHARED_LIBRARIES	:= vrapi
 
-LOCAL_LDLIBS    += -lOpenSLES
+LOCAL_LDLIBS    += -lOpenSLES -lz
 
 APP_STL := c++_static
 LOCAL_C_INCLUDES := ../Src/ ../../../VrEmulators/BeetleVBLibretroGo/mednafen/ ../../../VrEmulators/FreeType/include/ ../../../ ../../../VrEmulators/ ../../FrontendGo/
 
 include $(BUILD_SHARED_LIBRARY)
 
+# headless batch runner for boot tests, thumbnails, replays and captures over many roms
+include $(CLEAR_VARS)
+
+include ../../../cflags.mk
+
+LOCAL_MODULE			:= vbbatch
+LOCAL_SRC_FILES			:= 	../../Src/BatchMain.cpp \
+							../../Src/BatchRunner.cpp \
+							../../Src/EmulatorContext.cpp \
+							../../Src/FlightRecorder.cpp \
+							../../Src/Capture.cpp \
+							../../Src/MemoryTracker.cpp \
+							../../Src/BufferPool.cpp \
+							../../Src/StateFile.cpp \
+							../../Src/FrameScheduler.cpp
+
+LOCAL_STATIC_LIBRARIES	:= vbEmulator
+
+LOCAL_LDLIBS    += -lz
+
+APP_STL := c++_static
+LOCAL_C_INCLUDES := ../Src/ ../../../VrEmulators/BeetleVBLibretroGo/mednafen/ ../../../VrEmulators/
+
+include $(BUILD_EXECUTABLE)
+
+# two netplay players over the loopback with latency, jitter and loss, their states have to match
+include $(CLEAR_VARS)
+
+include ../../../cflags.mk
+
+LOCAL_MODULE			:= vbnetplay
+LOCAL_SRC_FILES			:= 	../../Src/NetplayMain.cpp \
+							../../Src/Netplay.cpp \
+							../../Src/EmulatorContext.cpp
+
+LOCAL_STATIC_LIBRARIES	:= vbEmulator
+
+LOCAL_LDLIBS    += -lz
+
+APP_STL := c++_static
+LOCAL_C_INCLUDES := ../Src/ ../../../VrEmulators/BeetleVBLibretroGo/mednafen/ ../../../VrEmulators/
+
+include $(BUILD_EXECUTABLE)
+
+# follows the frames published by the frame export
+include $(CLEAR_VARS)
+
+include ../../../cflags.mk
+
+LOCAL_MODULE			:= vbframes
+LOCAL_SRC_FILES			:= 	../../Src/FrameExportMain.cpp \
+							../../Src/FrameExport.cpp \
+							../../Src/MemoryTracker.cpp
+
+APP_STL := c++_static
+LOCAL_C_INCLUDES := ../Src/
+
+include $(BUILD_EXECUTABLE)
+
+# downloads from a throttled local server through the remote library, broken servers have to fail
+include $(CLEAR_VARS)
+
+include ../../../cflags.mk
+
+LOCAL_MODULE			:= vblibrary
+LOCAL_SRC_FILES			:= 	../../Src/LibraryMain.cpp \
+							../../Src/RemoteLibrary.cpp \
+							../../Src/RomCache.cpp
+
+LOCAL_LDLIBS    += -lz
+
+APP_STL := c++_static
+LOCAL_C_INCLUDES := ../Src/
+
+include $(BUILD_EXECUTABLE)
+
+# plays frame time traces to the performance governor and checks when it degrades and recovers
+include $(CLEAR_VARS)
+
+include ../../../cflags.mk
+
+LOCAL_MODULE			:= vbgovernor
+LOCAL_SRC_FILES			:= 	../../Src/GovernorMain.cpp \
+							../../Src/PerformanceGovernor.cpp
+
+APP_STL := c++_static
+LOCAL_C_INCLUDES := ../Src/
+
+include $(BUILD_EXECUTABLE)
+
 $(call import-module,VrEmulators/BeetleVBLibretroGo/jni)
 $(call import-module,VrEmulators/FreeType)
 
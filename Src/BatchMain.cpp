@@ -0,0 +1,101 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vrvb.h>
+
+#include "BatchRunner.h"
+
+// vbbatch <job file> [worker count]
+// every line of the job file is one job with tab separated fields:
+// <boot|thumbnail|replay|capture|convert|cycle|menu> <frames> <rom path> [output path] [replay path] [expected crc]
+// the cycle job takes the number of cycles instead of frames and needs a path for its state file
+
+namespace {
+
+    bool ParseType(const std::string &name, BatchRunner::JobType &type) {
+        if (name == "boot")
+            type = BatchRunner::JobBootTest;
+        else if (name == "thumbnail")
+            type = BatchRunner::JobThumbnail;
+        else if (name == "replay")
+            type = BatchRunner::JobReplay;
+        else if (name == "capture")
+            type = BatchRunner::JobCapture;
+        else if (name == "convert")
+            type = BatchRunner::JobConvert;
+        else if (name == "cycle")
+            type = BatchRunner::JobCycle;
+        else if (name == "menu")
+            type = BatchRunner::JobMenu;
+        else
+            return false;
+        return true;
+    }
+
+    bool ReadJobs(const char *path, std::vector<BatchRunner::Job> &jobs) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            fprintf(stderr, "could not open %s\n", path);
+            return false;
+        }
+
+        std::string line;
+        for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::vector<std::string> fields;
+            std::stringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, '\t'))
+                fields.push_back(field);
+
+            BatchRunner::Job job = {};
+            if (fields.size() < 3 || !ParseType(fields[0], job.type)) {
+                fprintf(stderr, "%s:%i: invalid job\n", path, lineNumber);
+                return false;
+            }
+            job.frames = (uint32_t) strtoul(fields[1].c_str(), nullptr, 10);
+            job.romPath = fields[2];
+            if (fields.size() > 3)
+                job.outputPath = fields[3];
+            if (fields.size() > 4)
+                job.replayPath = fields[4];
+            if (fields.size() > 5)
+                job.expectedCrc = (uint32_t) strtoul(fields[5].c_str(), nullptr, 16);
+            jobs.push_back(job);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <job file> [worker count]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<BatchRunner::Job> jobs;
+    if (!ReadJobs(argv[1], jobs))
+        return 2;
+    int workerCount = argc > 2 ? atoi(argv[2]) : 0;
+
+    // the workers get forked with the initialized core
+    VRVB::Init();
+
+    std::vector<BatchRunner::Result> results;
+    BatchRunner::Run(jobs, results, workerCount);
+
+    int failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const BatchRunner::Result &result = results[i];
+        printf("%s\t%s\t%u frames\t%08x\t%.2fs\t%s\t%s\n", result.success ? "ok" : result.crashed ? "crashed" : "failed",
+               jobs[i].romPath.c_str(), result.framesRun, result.frameCrc, result.seconds, jobs[i].outputPath.c_str(), result.report);
+        if (!result.success)
+            failed++;
+    }
+    printf("%i of %i jobs failed\n", failed, (int) jobs.size());
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,469 @@
+#include "BatchRunner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <vrvb.h>
+#include <chrono>
+
+#include "EmulatorContext.h"
+#include "FlightRecorder.h"
+#include "Capture.h"
+#include "ScreenLayout.h"
+#include "BufferPool.h"
+#include "MemoryTracker.h"
+#include "StateFile.h"
+#include "FrameScheduler.h"
+
+namespace BatchRunner {
+
+    namespace {
+        struct Worker {
+            pid_t pid;
+            int pipe;
+            size_t job;
+        };
+
+        Capture::Recorder *jobRecorder;
+
+        void HeadlessVideo(Emulator::Context &context, const void *data, unsigned width, unsigned height) {
+            context.currentScreenData = data;
+            if (jobRecorder)
+                jobRecorder->PushFrame((const uint8_t *) data);
+        }
+
+        void HeadlessAudio(Emulator::Context &context, int16_t *samples, int32_t sampleCount) {
+            if (jobRecorder)
+                jobRecorder->PushAudio(samples, sampleCount);
+        }
+
+        bool ReadFile(const std::string &path, std::vector<uint8_t> &data) {
+            std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+                return false;
+
+            data.resize((size_t) file.tellg());
+            file.seekg(0, std::ios::beg);
+            file.read((char *) data.data(), data.size());
+            return !file.fail();
+        }
+
+        // input for every emulated frame of the last run of the rom that started at power on; the dump gets
+        // rejected if the ring does not reach back to frame 0 or a state got loaded in between
+        bool LoadReplay(const std::string &path, uint32_t romHash, std::vector<uint32_t> &inputs) {
+            FlightRecorder::Dump dump;
+            if (!FlightRecorder::ReadDump(path, dump))
+                return false;
+
+            bool fromPowerOn = false;
+            for (const FlightRecorder::FrameRecord &record : dump.frames) {
+                if (record.romHash != romHash)
+                    continue;
+
+                bool replayable = (record.flags & FlightRecorder::FrameFromPowerOn) != 0;
+                if (replayable && record.frame == 0) {
+                    // the rom got loaded or reset again
+                    inputs.clear();
+                    fromPowerOn = true;
+                } else if (!replayable || record.frame != inputs.size()) {
+                    fromPowerOn = false;
+                }
+
+                if (fromPowerOn)
+                    inputs.push_back(record.input);
+            }
+            return fromPowerOn && !inputs.empty();
+        }
+
+        // enough runs of a conversion to get stable timings
+        const int CONVERT_REPEATS = 2000;
+
+        template<typename Function>
+        double MicrosPerRun(Function function) {
+            auto startTime = std::chrono::steady_clock::now();
+            for (int i = 0; i < CONVERT_REPEATS; ++i)
+                function();
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / CONVERT_REPEATS;
+        }
+
+        void BenchmarkLayouts(const uint8_t *frame, char *report, size_t reportSize) {
+            const float color[3] = {1.0f, 0.0f, 0.0f};
+            uint32_t palette[256];
+            ScreenLayout::BuildPalette(color, palette);
+            std::vector<uint32_t> rgba(ScreenLayout::Size<ScreenLayout::Stacked>::width * ScreenLayout::Size<ScreenLayout::Stacked>::height);
+            std::vector<uint8_t> eyes(Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT * 2);
+
+            double stacked = MicrosPerRun([&]() { ScreenLayout::Convert<ScreenLayout::Stacked>(frame, rgba.data(), palette); });
+            double mono = MicrosPerRun([&]() { ScreenLayout::Convert<ScreenLayout::Mono>(frame, rgba.data(), palette); });
+            double copy = MicrosPerRun([&]() { ScreenLayout::CopyEyes(frame, eyes.data()); });
+            // the float multiply per pixel every conversion did before the palette
+            double multiply = MicrosPerRun([&]() {
+                for (int i = 0; i < Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT; ++i)
+                    rgba[i] = 0xFF000000 | ((uint32_t) (frame[i] * color[2]) << 16) | ((uint32_t) (frame[i] * color[1]) << 8) |
+                              (uint32_t) (frame[i] * color[0]);
+            });
+
+            snprintf(report, reportSize, "stacked %.1fus, mono %.1fus, eyes %.1fus, mono with a multiply per pixel %.1fus", stacked,
+                     mono, copy, multiply);
+        }
+
+        // same frame rate, scheduler share and slot image chunks as the app
+        const double MENU_FRAME_PERIOD = 1 / 72.0;
+        const double MENU_SCHEDULER_SHARE = 0.5;
+        const int MENU_CHUNK_ROWS = Emulator::VIDEO_HEIGHT / 4;
+        // frames between two palette presses
+        const uint32_t MENU_PRESS_INTERVAL = 8;
+        // frames emulated to get a screen before the menu opens
+        const uint32_t MENU_EMULATED_FRAMES = 30;
+
+        // the slowest frames of a sandbox or a desktop are mostly the scheduler of the os, the 99th
+        // percentile shows the spikes of the work itself
+        struct FrameCost {
+            std::vector<double> costs;
+
+            double Mean() const {
+                double sum = 0;
+                for (double cost : costs)
+                    sum += cost;
+                return sum / costs.size();
+            }
+
+            double Deviation() const {
+                double mean = Mean(), squareSum = 0;
+                for (double cost : costs)
+                    squareSum += (cost - mean) * (cost - mean);
+                return sqrt(squareSum / costs.size());
+            }
+
+            double Percentile(double share) const {
+                std::vector<double> sorted = costs;
+                std::sort(sorted.begin(), sorted.end());
+                return sorted[std::min(sorted.size() - 1, (size_t) (sorted.size() * share))];
+            }
+        };
+
+        // the cpu side of a palette press: the screen gets converted for each of the three colors and the
+        // palette, the slot image once; the texture uploads can not be measured without gl
+        void MeasureMenuFrames(const uint8_t *frame, uint32_t frames, char *report, size_t reportSize) {
+            const float color[3] = {1.0f, 0.0f, 0.0f};
+            uint32_t palette[256];
+            ScreenLayout::BuildPalette(color, palette);
+            std::vector<uint32_t> screen(ScreenLayout::Size<ScreenLayout::Stacked>::width * ScreenLayout::Size<ScreenLayout::Stacked>::height);
+            std::vector<uint32_t> slotImage(Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT);
+
+            auto convertScreen = [&]() { ScreenLayout::Convert<ScreenLayout::Stacked>(frame, screen.data(), palette); };
+            auto convertSlotRows = [&](int startY, int rowCount) {
+                int endY = std::min(startY + rowCount, Emulator::VIDEO_HEIGHT);
+                for (int y = startY; y < endY; ++y)
+                    ScreenLayout::ConvertRow(frame + y * Emulator::VIDEO_WIDTH, slotImage.data() + y * Emulator::VIDEO_WIDTH, palette);
+                return endY == Emulator::VIDEO_HEIGHT;
+            };
+
+            FrameCost immediate, deferred;
+            for (uint32_t i = 0; i < frames; ++i) {
+                auto startTime = std::chrono::steady_clock::now();
+                if (i % MENU_PRESS_INTERVAL == 0) {
+                    for (int update = 0; update < 4; ++update)
+                        convertScreen();
+                    convertSlotRows(0, Emulator::VIDEO_HEIGHT);
+                }
+                immediate.costs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+            }
+
+            FrameScheduler scheduler;
+            for (uint32_t i = 0; i < frames; ++i) {
+                auto startTime = std::chrono::steady_clock::now();
+                if (i % MENU_PRESS_INTERVAL == 0) {
+                    for (int update = 0; update < 4; ++update)
+                        scheduler.Post("screen", FrameScheduler::PriorityHigh, [&]() {
+                            convertScreen();
+                            return true;
+                        });
+                    int startY = 0;
+                    scheduler.Post("state image", FrameScheduler::PriorityNormal, [&, startY]() mutable {
+                        bool done = convertSlotRows(startY, MENU_CHUNK_ROWS);
+                        startY += MENU_CHUNK_ROWS;
+                        return done;
+                    });
+                }
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                scheduler.Run(MENU_SCHEDULER_SHARE * MENU_FRAME_PERIOD - elapsed);
+                deferred.costs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+            }
+
+            snprintf(report, reportSize, "right away: mean %.0fus, deviation %.0fus, p99 %.0fus; scheduled: mean %.0fus, "
+                                         "deviation %.0fus, p99 %.0fus", immediate.Mean() * 1e6, immediate.Deviation() * 1e6,
+                     immediate.Percentile(0.99) * 1e6, deferred.Mean() * 1e6, deferred.Deviation() * 1e6,
+                     deferred.Percentile(0.99) * 1e6);
+        }
+
+        // frames played between loading the rom and saving and again after loading the state
+        const int CYCLE_FRAMES = 30;
+
+        long ResidentKb() {
+            std::ifstream statm("/proc/self/statm");
+            long pages = 0, resident = 0;
+            statm >> pages >> resident;
+            return resident * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+
+        // one game switch with a save and a load, the buffers come from pools like in the app
+        bool RunCycle(const Job &job, Emulator::Context &context, BufferPool &romBuffers, BufferPool &stateBuffers) {
+            {
+                BufferPool::Buffer rom = romBuffers.Acquire(0);
+                if (!ReadFile(job.romPath, *rom))
+                    return false;
+                context.currentRomHash = (uint32_t) crc32(0, rom->data(), (uInt) rom->size());
+                VRVB::LoadRom(rom->data(), rom->size());
+            }
+
+            for (int i = 0; i < CYCLE_FRAMES; ++i)
+                VRVB::Run();
+
+            StateFile::Identity identity = {1, context.currentRomHash, (uint32_t) VRVB::retro_serialize_size()};
+            {
+                BufferPool::Buffer state = stateBuffers.Acquire(identity.stateSize);
+                state->resize(identity.stateSize);
+                if (!VRVB::retro_serialize(state->data(), state->size()) ||
+                    !StateFile::Write(job.outputPath, identity, state->data(), state->size()))
+                    return false;
+            }
+            {
+                BufferPool::Buffer state = stateBuffers.Acquire(identity.stateSize);
+                if (StateFile::Read(job.outputPath, identity, *state) != StateFile::StatusValid ||
+                    !VRVB::retro_unserialize(state->data(), state->size()))
+                    return false;
+            }
+
+            for (int i = 0; i < CYCLE_FRAMES; ++i)
+                VRVB::Run();
+            context.emulatedFrame += CYCLE_FRAMES * 2;
+            return true;
+        }
+
+        // the first cycle fills the pools, everything the later ones keep is reported as a leak
+        bool RunCycles(const Job &job, Emulator::Context &context, char *report, size_t reportSize) {
+            BufferPool romBuffers(MemoryTracker::TagLibrary);
+            BufferPool stateBuffers(MemoryTracker::TagStates);
+            if (job.frames == 0 || job.outputPath.empty() || !RunCycle(job, context, romBuffers, stateBuffers))
+                return false;
+
+            MemoryTracker::TagStats marked[MemoryTracker::TAG_COUNT];
+            for (int i = 0; i < MemoryTracker::TAG_COUNT; ++i)
+                marked[i] = MemoryTracker::GetStats((MemoryTracker::Tag) i);
+            long markedKb = ResidentKb();
+
+            for (uint32_t cycle = 1; cycle < job.frames; ++cycle)
+                if (!RunCycle(job, context, romBuffers, stateBuffers))
+                    return false;
+            remove(job.outputPath.c_str());
+
+            int64_t growth = 0;
+            int32_t openAllocations = 0;
+            std::string grownTags;
+            for (int i = 0; i < MemoryTracker::TAG_COUNT; ++i) {
+                MemoryTracker::TagStats stats = MemoryTracker::GetStats((MemoryTracker::Tag) i);
+                int64_t tagGrowth = stats.bytes - marked[i].bytes;
+                growth += tagGrowth;
+                openAllocations += (int32_t) (stats.allocations - marked[i].allocations) - (int32_t) (stats.frees - marked[i].frees);
+                if (tagGrowth != 0)
+                    grownTags += std::string(" ") + MemoryTracker::TagName((MemoryTracker::Tag) i);
+            }
+
+            // the resident size also covers the core, it is only shown because the allocator does not give everything back
+            snprintf(report, reportSize, "%u cycles, tracked %+lld bytes in %i allocs%s, resident %+ld kb", job.frames,
+                     (long long) growth, openAllocations, grownTags.c_str(), ResidentKb() - markedKb);
+            return growth == 0 && openAllocations == 0;
+        }
+
+        bool FrameIsBlank(const uint8_t *frame) {
+            for (int i = 0; i < Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT; ++i)
+                if (frame[i])
+                    return false;
+            return true;
+        }
+
+        Result RunJob(const Job &job) {
+            Result result = {};
+            auto startTime = std::chrono::steady_clock::now();
+
+            Emulator::Context context;
+            context.videoCallback = HeadlessVideo;
+            context.audioCallback = HeadlessAudio;
+            Emulator::SetActiveContext(&context);
+
+            std::vector<uint8_t> rom;
+            if (!ReadFile(job.romPath, rom))
+                return result;
+
+            context.currentRomHash = (uint32_t) crc32(0, rom.data(), (uInt) rom.size());
+            VRVB::LoadRom(rom.data(), rom.size());
+
+            std::vector<uint32_t> inputs;
+            uint32_t frames = job.frames;
+            if (job.type == JobReplay) {
+                if (!LoadReplay(job.replayPath, context.currentRomHash, inputs))
+                    return result;
+                frames = (uint32_t) inputs.size();
+            }
+
+            // the worker has no frame deadline so the recorder waits for the writer instead of dropping frames
+            Capture::Recorder recorder;
+            if (job.type == JobCapture) {
+                if (!recorder.Start(job.outputPath, 50270, true))
+                    return result;
+                jobRecorder = &recorder;
+            }
+
+            // the cycle job does its own loading and counts cycles instead of frames
+            bool cycled = false;
+            if (job.type == JobCycle) {
+                cycled = RunCycles(job, context, result.report, sizeof(result.report));
+                frames = 0;
+            }
+            // the menu job only needs a frame to convert, its frames are menu frames
+            if (job.type == JobMenu)
+                frames = std::min(frames, MENU_EMULATED_FRAMES);
+
+            for (uint32_t i = 0; i < frames; ++i) {
+                VRVB::input_buf[0] = i < inputs.size() ? inputs[i] : 0;
+                VRVB::Run();
+                context.emulatedFrame++;
+            }
+            result.framesRun = context.emulatedFrame;
+
+            if (jobRecorder) {
+                recorder.Stop();
+                jobRecorder = nullptr;
+            }
+
+            const uint8_t *frame = (const uint8_t *) context.currentScreenData;
+            if (frame)
+                result.frameCrc = (uint32_t) crc32(0, frame, Emulator::CORE_FRAME_SIZE);
+
+            switch (job.type) {
+                case JobBootTest:
+                    result.success = frame && !FrameIsBlank(frame);
+                    break;
+                case JobThumbnail:
+                    if (frame) {
+                        std::ofstream outfile(job.outputPath, std::ios::trunc | std::ios::binary);
+                        outfile.write((const char *) frame, Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT);
+                        result.success = !outfile.fail();
+                    }
+                    break;
+                case JobReplay:
+                    result.success = frame && (job.expectedCrc == 0 || job.expectedCrc == result.frameCrc);
+                    break;
+                case JobCapture:
+                    result.success = recorder.GetStats().framesWritten == result.framesRun;
+                    break;
+                case JobConvert:
+                    if (frame) {
+                        BenchmarkLayouts(frame, result.report, sizeof(result.report));
+                        result.success = true;
+                    }
+                    break;
+                case JobCycle:
+                    result.success = cycled;
+                    break;
+                case JobMenu:
+                    if (frame && job.frames > 0) {
+                        MeasureMenuFrames(frame, job.frames, result.report, sizeof(result.report));
+                        result.success = true;
+                    }
+                    break;
+            }
+
+            result.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+            return result;
+        }
+
+        bool StartWorker(const std::vector<Job> &jobs, size_t job, Worker &worker) {
+            int fds[2];
+            if (pipe(fds) != 0)
+                return false;
+
+            pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                return false;
+            }
+
+            if (pid == 0) {
+                close(fds[0]);
+                // a crashing job only gets reported through the exit status
+                FlightRecorder::Uninstall();
+                Result result = RunJob(jobs[job]);
+                ssize_t written = write(fds[1], &result, sizeof(Result));
+                // skip the atexit handlers and static destructors of the parent
+                _exit(written == sizeof(Result) ? 0 : 1);
+            }
+
+            close(fds[1]);
+            worker.pid = pid;
+            worker.pipe = fds[0];
+            worker.job = job;
+            return true;
+        }
+
+        void FinishWorker(const Worker &worker, std::vector<Result> &results) {
+            Result &result = results[worker.job];
+            if (read(worker.pipe, &result, sizeof(Result)) != sizeof(Result))
+                result = {};
+            close(worker.pipe);
+        }
+    }
+
+    void Run(const std::vector<Job> &jobs, std::vector<Result> &results, int workerCount) {
+        if (workerCount <= 0)
+            workerCount = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (workerCount <= 0)
+            workerCount = 1;
+
+        results.assign(jobs.size(), Result());
+
+        std::vector<Worker> workers;
+        size_t nextJob = 0;
+        while (nextJob < jobs.size() || !workers.empty()) {
+            while (nextJob < jobs.size() && (int) workers.size() < workerCount) {
+                Worker worker;
+                if (StartWorker(jobs, nextJob, worker))
+                    workers.push_back(worker);
+                nextJob++;
+            }
+
+            if (workers.empty())
+                continue;
+
+            // a worker closes its pipe when it is done or has crashed
+            std::vector<pollfd> fds(workers.size());
+            for (size_t i = 0; i < workers.size(); ++i)
+                fds[i] = {workers[i].pipe, POLLIN, 0};
+            if (poll(fds.data(), fds.size(), -1) < 0)
+                continue;
+
+            for (size_t i = workers.size(); i-- > 0;) {
+                if (!fds[i].revents)
+                    continue;
+
+                int status = 0;
+                FinishWorker(workers[i], results);
+                waitpid(workers[i].pid, &status, 0);
+                if (WIFSIGNALED(status)) {
+                    results[workers[i].job].success = false;
+                    results[workers[i].job].crashed = true;
+                }
+                workers.erase(workers.begin() + i);
+            }
+        }
+    }
+
+}  // namespace BatchRunner
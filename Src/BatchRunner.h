@@ -0,0 +1,61 @@
+#ifndef VB_BATCH_RUNNER_H
+#define VB_BATCH_RUNNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs headless jobs (boot tests, thumbnails, input replays, captures) over many roms at once.
+// The core keeps its state in globals, so every job runs in a forked worker process with its
+// own copy of the core and its own emulator context; no gl is used by the workers.
+// VRVB::Init has to have been called before the workers get forked. It is built into the
+// vbbatch executable (BatchMain.cpp) and not into the app, forking the app with all its
+// threads would only leave the forking thread alive in the workers.
+namespace BatchRunner {
+
+    enum JobType {
+        // runs the rom and checks that it presents a frame that is not blank
+        JobBootTest,
+        // writes the left eye of the last frame to outputPath, same format as the .stateimg files
+        JobThumbnail,
+        // plays back the inputs of a flight recorder dump, the dump has to reach back to power on
+        JobReplay,
+        // records every frame and the audio into a capture file at outputPath
+        JobCapture,
+        // times every ScreenLayout conversion of the last frame
+        JobConvert,
+        // loads the rom, saves a state to outputPath and loads it again <frames> times over the same io
+        // paths as the app; fails if the tracked memory grew after the first cycle
+        JobCycle,
+        // presses a palette button every few of <frames> menu frames and reports the deviation of the frame
+        // cost with the screen and slot image conversions done right away and through the frame scheduler
+        JobMenu
+    };
+
+    struct Job {
+        JobType type;
+        std::string romPath;
+        std::string outputPath;
+        std::string replayPath;
+        uint32_t frames;
+        // replay: crc of the last frame a previous build produced, 0 to only record it
+        uint32_t expectedCrc;
+    };
+
+    struct Result {
+        bool success;
+        // the worker got killed by a signal
+        bool crashed;
+        uint32_t framesRun;
+        uint32_t frameCrc;
+        float seconds;
+        // what the job measured, empty for most jobs
+        char report[160];
+    };
+
+    // runs the jobs with at most workerCount processes at the same time, 0 uses one per cpu
+    void Run(const std::vector<Job> &jobs, std::vector<Result> &results, int workerCount);
+
+}  // namespace BatchRunner
+
+#endif
@@ -0,0 +1,88 @@
+#include "BufferPool.h"
+
+BufferPool::Buffer::Buffer(BufferPool *pool, std::vector<uint8_t> *data)
+        : pool(pool), data(data), acquiredCapacity(data->capacity()) {}
+
+BufferPool::Buffer::Buffer(Buffer &&other)
+        : pool(other.pool), data(other.data), acquiredCapacity(other.acquiredCapacity) {
+    other.data = nullptr;
+}
+
+BufferPool::Buffer::~Buffer() {
+    if (data)
+        pool->Release(data, acquiredCapacity);
+}
+
+BufferPool::BufferPool(MemoryTracker::Tag tag, size_t maxFreeBuffers) : tag(tag), maxFreeBuffers(maxFreeBuffers) {}
+
+BufferPool::~BufferPool() {
+    for (std::vector<uint8_t> *buffer : freeBuffers) {
+        MemoryTracker::Freed(tag, buffer->capacity());
+        delete buffer;
+    }
+}
+
+BufferPool::Buffer BufferPool::Acquire(size_t capacity) {
+    std::vector<uint8_t> *data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.acquires++;
+
+        // the smallest buffer that fits, otherwise the biggest one gets grown
+        size_t best = freeBuffers.size();
+        for (size_t i = 0; i < freeBuffers.size(); ++i) {
+            size_t current = freeBuffers[i]->capacity();
+            if (best == freeBuffers.size()) {
+                best = i;
+                continue;
+            }
+            size_t bestCapacity = freeBuffers[best]->capacity();
+            bool fits = current >= capacity;
+            bool bestFits = bestCapacity >= capacity;
+            if ((fits && (!bestFits || current < bestCapacity)) || (!fits && !bestFits && current > bestCapacity))
+                best = i;
+        }
+
+        if (best < freeBuffers.size()) {
+            data = freeBuffers[best];
+            freeBuffers.erase(freeBuffers.begin() + best);
+        }
+    }
+
+    if (!data)
+        data = new std::vector<uint8_t>();
+    data->clear();
+
+    if (data->capacity() < capacity) {
+        size_t previousCapacity = data->capacity();
+        data->reserve(capacity);
+        MemoryTracker::Freed(tag, previousCapacity);
+        MemoryTracker::Allocated(tag, data->capacity());
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.allocations++;
+        stats.bytesAllocated += data->capacity();
+    }
+    return Buffer(this, data);
+}
+
+BufferPool::Stats BufferPool::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void BufferPool::Release(std::vector<uint8_t> *data, size_t acquiredCapacity) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (data->capacity() > acquiredCapacity) {
+        stats.allocations++;
+        stats.bytesAllocated += data->capacity();
+        MemoryTracker::Freed(tag, acquiredCapacity);
+        MemoryTracker::Allocated(tag, data->capacity());
+    }
+
+    if (freeBuffers.size() < maxFreeBuffers) {
+        freeBuffers.push_back(data);
+    } else {
+        MemoryTracker::Freed(tag, data->capacity());
+        delete data;
+    }
+}
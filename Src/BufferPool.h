@@ -0,0 +1,64 @@
+#ifndef VB_BUFFER_POOL_H
+#define VB_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "MemoryTracker.h"
+
+// Reusable byte buffers for the file io paths. Buffers keep their capacity when they go back
+// into the pool, so loading and saving the same sizes again does not touch the heap.
+class BufferPool {
+public:
+    struct Stats {
+        uint32_t acquires;
+        // new buffers and buffers that had to grow
+        uint32_t allocations;
+        uint64_t bytesAllocated;
+    };
+
+    // hands the buffer back to the pool when it goes out of scope
+    class Buffer {
+    public:
+        Buffer(BufferPool *pool, std::vector<uint8_t> *data);
+
+        Buffer(Buffer &&other);
+
+        Buffer(const Buffer &) = delete;
+
+        Buffer &operator=(const Buffer &) = delete;
+
+        ~Buffer();
+
+        std::vector<uint8_t> &operator*() { return *data; }
+
+        std::vector<uint8_t> *operator->() { return data; }
+
+    private:
+        BufferPool *pool;
+        std::vector<uint8_t> *data;
+        size_t acquiredCapacity;
+    };
+
+    explicit BufferPool(MemoryTracker::Tag tag, size_t maxFreeBuffers = 4);
+
+    ~BufferPool();
+
+    // the buffer is empty but has room for at least capacity bytes
+    Buffer Acquire(size_t capacity);
+
+    Stats GetStats();
+
+private:
+    void Release(std::vector<uint8_t> *data, size_t acquiredCapacity);
+
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t> *> freeBuffers;
+    MemoryTracker::Tag tag;
+    size_t maxFreeBuffers;
+    Stats stats = {};
+};
+
+#endif
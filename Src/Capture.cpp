@@ -0,0 +1,181 @@
+#include "Capture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+#include "EmulatorContext.h"
+#include "MemoryTracker.h"
+#include "ScreenLayout.h"
+
+namespace Capture {
+
+    namespace {
+        const int EYE_SIZE = Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT;
+        const int VIDEO_SIZE = EYE_SIZE * 2;
+        // more than the core produces in a frame
+        const int MAX_AUDIO_SAMPLES = 2048;
+    }
+
+    Recorder::~Recorder() {
+        Stop();
+        if (!slots.empty()) {
+            MemoryTracker::Freed(MemoryTracker::TagVideo, POOL_SIZE * VIDEO_SIZE);
+            MemoryTracker::Freed(MemoryTracker::TagAudio, POOL_SIZE * MAX_AUDIO_SAMPLES * 2 * sizeof(int16_t));
+        }
+    }
+
+    bool Recorder::Start(const std::string &path, uint32_t frameRate, bool waitForSlot) {
+        Stop();
+
+        file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        FileHeader header = {FILE_MAGIC, VERSION, (uint32_t) Emulator::VIDEO_WIDTH, (uint32_t) Emulator::VIDEO_HEIGHT, 2, frameRate};
+        fwrite(&header, sizeof(header), 1, file);
+
+        if (slots.empty()) {
+            slots.resize(POOL_SIZE);
+            for (Slot &slot : slots)
+                slot.data.resize(VIDEO_SIZE + MAX_AUDIO_SAMPLES * 2 * sizeof(int16_t));
+            MemoryTracker::Allocated(MemoryTracker::TagVideo, POOL_SIZE * VIDEO_SIZE);
+            MemoryTracker::Allocated(MemoryTracker::TagAudio, POOL_SIZE * MAX_AUDIO_SAMPLES * 2 * sizeof(int16_t));
+        }
+        freeSlots.clear();
+        for (int i = 0; i < POOL_SIZE; ++i)
+            freeSlots.push_back(i);
+        queuedSlots.clear();
+        pendingAudio.clear();
+        pendingAudio.reserve(MAX_AUDIO_SAMPLES * 2);
+
+        frameIndex = 0;
+        framesWritten = 0;
+        framesDropped = 0;
+        bytesWritten = sizeof(header);
+
+        this->waitForSlot = waitForSlot;
+        stopping = false;
+        recording = true;
+        writer = std::thread(&Recorder::WriterThread, this);
+        return true;
+    }
+
+    void Recorder::Stop() {
+        if (!recording)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queueCondition.notify_one();
+        writer.join();
+        recording = false;
+
+        FrameHeader end = {END_MAGIC, frameIndex, 0, 0, 0, framesDropped};
+        fwrite(&end, sizeof(end), 1, file);
+        fclose(file);
+        file = nullptr;
+    }
+
+    void Recorder::PushAudio(const int16_t *samples, int32_t sampleCount) {
+        if (!recording)
+            return;
+
+        size_t count = std::min((size_t) sampleCount * 2, (size_t) MAX_AUDIO_SAMPLES * 2 - pendingAudio.size());
+        pendingAudio.insert(pendingAudio.end(), samples, samples + count);
+    }
+
+    void Recorder::PushFrame(const uint8_t *frame) {
+        if (!recording)
+            return;
+
+        int slotIndex;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (waitForSlot)
+                freeCondition.wait(lock, [this] { return !freeSlots.empty(); });
+
+            if (freeSlots.empty()) {
+                framesDropped++;
+                frameIndex++;
+                pendingAudio.clear();
+                return;
+            }
+            slotIndex = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        // the slot belongs to the producer until it is queued
+        Slot &slot = slots[slotIndex];
+        slot.frame = frameIndex++;
+        ScreenLayout::CopyEyes(frame, slot.data.data());
+        memcpy(slot.data.data() + VIDEO_SIZE, pendingAudio.data(), pendingAudio.size() * sizeof(int16_t));
+        slot.audioSamples = (uint32_t) (pendingAudio.size() / 2);
+        pendingAudio.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queuedSlots.push_back(slotIndex);
+        }
+        queueCondition.notify_one();
+    }
+
+    Stats Recorder::GetStats() const {
+        return {framesWritten, framesDropped, bytesWritten};
+    }
+
+    void Recorder::WriterThread() {
+        std::vector<uint8_t> compressed(compressBound(slots[0].data.size()));
+
+        while (true) {
+            int slotIndex;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queueCondition.wait(lock, [this] { return stopping || !queuedSlots.empty(); });
+                // the queued frames still get written when stopping
+                if (queuedSlots.empty())
+                    break;
+                slotIndex = queuedSlots.front();
+                queuedSlots.pop_front();
+            }
+
+            Slot &slot = slots[slotIndex];
+            uLongf compressedSize = (uLongf) compressed.size();
+            size_t rawSize = VIDEO_SIZE + slot.audioSamples * 2 * sizeof(int16_t);
+            if (compress2(compressed.data(), &compressedSize, slot.data.data(), (uLong) rawSize, Z_BEST_SPEED) == Z_OK) {
+                FrameHeader header = {FRAME_MAGIC, slot.frame, (uint32_t) compressedSize, (uint32_t) VIDEO_SIZE, slot.audioSamples,
+                                      framesDropped};
+                fwrite(&header, sizeof(header), 1, file);
+                fwrite(compressed.data(), 1, compressedSize, file);
+                framesWritten++;
+                bytesWritten += sizeof(header) + compressedSize;
+            } else {
+                framesDropped++;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeSlots.push_back(slotIndex);
+            }
+            freeCondition.notify_one();
+        }
+    }
+
+    void SaveScreenshot(const std::string &path, const uint8_t *frame) {
+        std::vector<uint8_t> image(VIDEO_SIZE);
+        ScreenLayout::CopyEyes(frame, image.data());
+
+        std::thread([path](std::vector<uint8_t> image) {
+            FILE *file = fopen(path.c_str(), "wb");
+            if (!file)
+                return;
+            fprintf(file, "P5\n%i %i\n255\n", Emulator::VIDEO_WIDTH, Emulator::VIDEO_HEIGHT * 2);
+            fwrite(image.data(), 1, image.size(), file);
+            fclose(file);
+        }, std::move(image)).detach();
+    }
+
+}  // namespace Capture
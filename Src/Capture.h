@@ -0,0 +1,113 @@
+#ifndef VB_CAPTURE_H
+#define VB_CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the 8 bit frames of the core (both eyes) together with the audio into a capture file.
+// The frame thread only copies the frame into a preallocated slot; compressing and writing is
+// done on a background thread. If the writer falls behind the frame gets dropped and counted.
+//
+// file layout, all values little endian:
+//   FileHeader
+//   FrameHeader + zlib stream (eye rows followed by the interleaved stereo samples), per frame
+//   FrameHeader with magic END_MAGIC and the final counters
+namespace Capture {
+
+    const uint32_t FILE_MAGIC = 0x50434256;  // "VBCP"
+    const uint32_t FRAME_MAGIC = 0x454d5246;  // "FRME"
+    const uint32_t END_MAGIC = 0x20444e45;  // "END "
+    const uint32_t VERSION = 1;
+
+    // frames that can wait for the writer
+    const int POOL_SIZE = 16;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        // height of one eye
+        uint32_t height;
+        uint32_t eyeCount;
+        // frames per second * 1000
+        uint32_t frameRate;
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        // index of the emulated frame since the start, gaps are dropped frames
+        uint32_t frame;
+        uint32_t compressedSize;
+        uint32_t videoSize;
+        // stereo sample pairs
+        uint32_t audioSamples;
+        uint32_t dropped;
+    };
+
+    struct Stats {
+        uint32_t framesWritten;
+        uint32_t framesDropped;
+        uint64_t bytesWritten;
+    };
+
+    class Recorder {
+    public:
+        ~Recorder();
+
+        // waitForSlot blocks the producer instead of dropping frames, used by the headless runner
+        bool Start(const std::string &path, uint32_t frameRate, bool waitForSlot = false);
+
+        void Stop();
+
+        bool IsRecording() const { return recording; }
+
+        // audio gets attached to the next frame that is pushed
+        void PushAudio(const int16_t *samples, int32_t sampleCount);
+
+        // frame in the layout the core hands out
+        void PushFrame(const uint8_t *frame);
+
+        Stats GetStats() const;
+
+    private:
+        struct Slot {
+            uint32_t frame;
+            std::vector<uint8_t> data;
+            uint32_t audioSamples;
+        };
+
+        void WriterThread();
+
+        std::vector<Slot> slots;
+        std::vector<int> freeSlots;
+        std::deque<int> queuedSlots;
+        std::mutex mutex;
+        std::condition_variable queueCondition;
+        std::condition_variable freeCondition;
+        std::thread writer;
+        FILE *file = nullptr;
+
+        bool recording = false;
+        bool stopping = false;
+        bool waitForSlot = false;
+
+        std::vector<int16_t> pendingAudio;
+        uint32_t frameIndex = 0;
+
+        std::atomic<uint32_t> framesWritten{0};
+        std::atomic<uint32_t> framesDropped{0};
+        std::atomic<uint64_t> bytesWritten{0};
+    };
+
+    // writes both eyes as a binary pgm on a background thread
+    void SaveScreenshot(const std::string &path, const uint8_t *frame);
+
+}  // namespace Capture
+
+#endif
@@ -0,0 +1,70 @@
+#include "Cheats.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace Cheats {
+
+    bool Load(const std::string &path, CheatList &list) {
+        list.cheats.clear();
+
+        std::ifstream file(path);
+        if (!file.is_open())
+            return false;
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream stream(line);
+            uint32_t address, value;
+            if (stream >> std::hex >> address >> value)
+                Set(list, address, (uint8_t) value);
+        }
+        return true;
+    }
+
+    bool Save(const std::string &path, const CheatList &list) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        file << "# address value\n" << std::hex;
+        for (const Cheat &cheat : list.cheats)
+            file << cheat.address << " " << (uint32_t) cheat.value << "\n";
+        return !file.fail();
+    }
+
+    void Set(CheatList &list, uint32_t address, uint8_t value) {
+        for (Cheat &cheat : list.cheats) {
+            if (cheat.address == address) {
+                cheat.value = value;
+                return;
+            }
+        }
+        list.cheats.push_back({address, value, false, 0});
+    }
+
+    bool CopyWithoutCheats(const CheatList &list, const uint8_t *memory, size_t size, std::vector<uint8_t> &copy) {
+        bool changed = false;
+        for (const Cheat &cheat : list.cheats) {
+            if (!cheat.applied || cheat.address >= size)
+                continue;
+            if (!changed)
+                copy.assign(memory, memory + size);
+            copy[cheat.address] = cheat.original;
+            changed = true;
+        }
+        return changed;
+    }
+
+    void Restore(CheatList &list, uint8_t *memory, size_t size) {
+        for (Cheat &cheat : list.cheats) {
+            if (cheat.applied && cheat.address < size)
+                memory[cheat.address] = cheat.original;
+            cheat.applied = false;
+        }
+    }
+
+}  // namespace Cheats
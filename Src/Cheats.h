@@ -0,0 +1,55 @@
+#ifndef VB_CHEATS_H
+#define VB_CHEATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per rom list of bytes that get forced to a value before every emulated frame.
+// Cheat files are text, one "address value" pair in hex per line; lines starting with # are ignored.
+namespace Cheats {
+
+    struct Cheat {
+        uint32_t address;
+        uint8_t value;
+        // the byte the cheat replaced the first time it got applied
+        bool applied;
+        uint8_t original;
+    };
+
+    struct CheatList {
+        std::vector<Cheat> cheats;
+        bool enabled = true;
+    };
+
+    bool Load(const std::string &path, CheatList &list);
+
+    bool Save(const std::string &path, const CheatList &list);
+
+    // adds or replaces the cheat for the address
+    void Set(CheatList &list, uint32_t address, uint8_t value);
+
+    inline void Apply(CheatList &list, uint8_t *memory, size_t size) {
+        if (!list.enabled)
+            return;
+        for (Cheat &cheat : list.cheats) {
+            if (cheat.address >= size)
+                continue;
+            if (!cheat.applied) {
+                cheat.original = memory[cheat.address];
+                cheat.applied = true;
+            }
+            memory[cheat.address] = cheat.value;
+        }
+    }
+
+    // copy of the memory with the replaced bytes put back, so frozen values do not end up in the save file
+    bool CopyWithoutCheats(const CheatList &list, const uint8_t *memory, size_t size, std::vector<uint8_t> &copy);
+
+    // puts the replaced bytes back into the memory, used when the cheats get turned off
+    void Restore(CheatList &list, uint8_t *memory, size_t size);
+
+}  // namespace Cheats
+
+#endif
@@ -0,0 +1,289 @@
+#include "CoverCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "EmulatorContext.h"
+#include "MemoryTracker.h"
+
+namespace {
+    // uploads are small but a burst of them while scrolling should still be spread over a few frames
+    const int MAX_UPLOADS_PER_FRAME = 4;
+    // bigger covers are refused before anything gets allocated for them
+    const int MAX_COVER_SIDE = 4096;
+
+    int ReadPgmNumber(FILE *file) {
+        int c = fgetc(file);
+        while (c == '#' || isspace(c)) {
+            if (c == '#')
+                while (c != '\n' && c != EOF)
+                    c = fgetc(file);
+            c = fgetc(file);
+        }
+
+        // numbers too long for an int count as invalid instead of wrapping around
+        int value = -1;
+        bool overflow = false;
+        while (c != EOF && isdigit(c)) {
+            overflow |= value > (INT_MAX - 9) / 10;
+            if (!overflow)
+                value = (value < 0 ? 0 : value * 10) + (c - '0');
+            c = fgetc(file);
+        }
+        return overflow ? -1 : value;
+    }
+
+    // only 8 bit binary pgm files, the same format the screenshots get saved in
+    bool ReadPgm(const std::string &path, int &width, int &height, std::vector<uint8_t> &pixels) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        bool valid = fgetc(file) == 'P' && fgetc(file) == '5';
+        if (valid) {
+            width = ReadPgmNumber(file);
+            height = ReadPgmNumber(file);
+            int maxValue = ReadPgmNumber(file);
+            valid = width > 0 && height > 0 && width <= MAX_COVER_SIDE && height <= MAX_COVER_SIDE && maxValue == 255;
+        }
+        if (valid) {
+            pixels.resize((size_t) width * height);
+            valid = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+        }
+
+        fclose(file);
+        return valid;
+    }
+
+    bool ReadStateImage(const std::string &path, std::vector<uint8_t> &pixels) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        pixels.resize(Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT);
+        bool valid = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+        fclose(file);
+        return valid;
+    }
+
+    // box filter down to the cover size, the color gets applied when drawing
+    void Downscale(const uint8_t *source, int width, int height, std::vector<uint32_t> &cover) {
+        cover.resize(CoverCache::COVER_WIDTH * CoverCache::COVER_HEIGHT);
+
+        for (int y = 0; y < CoverCache::COVER_HEIGHT; ++y) {
+            int startY = y * height / CoverCache::COVER_HEIGHT;
+            int endY = std::max(startY + 1, (y + 1) * height / CoverCache::COVER_HEIGHT);
+
+            for (int x = 0; x < CoverCache::COVER_WIDTH; ++x) {
+                int startX = x * width / CoverCache::COVER_WIDTH;
+                int endX = std::max(startX + 1, (x + 1) * width / CoverCache::COVER_WIDTH);
+
+                uint32_t sum = 0;
+                for (int sy = startY; sy < endY; ++sy)
+                    for (int sx = startX; sx < endX; ++sx)
+                        sum += source[sx + sy * width];
+
+                uint32_t value = sum / ((endX - startX) * (endY - startY));
+                cover[x + y * CoverCache::COVER_WIDTH] = 0xFF000000 | (value << 16) | (value << 8) | value;
+            }
+        }
+    }
+}
+
+CoverCache::~CoverCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void CoverCache::Init() {
+    slots.resize(SLOT_COUNT);
+    for (Slot &slot : slots) {
+        glGenTextures(1, &slot.texture);
+        glBindTexture(GL_TEXTURE_2D, slot.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, COVER_WIDTH, COVER_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        slot.lastUsed = 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    MemoryTracker::Allocated(MemoryTracker::TagGpu, SLOT_COUNT * COVER_WIDTH * COVER_HEIGHT * 4);
+
+    worker = std::thread(&CoverCache::WorkerThread, this);
+}
+
+GLuint CoverCache::Get(const std::string &key, const std::string &coverPath, const std::string &fallbackPath) {
+    bool enteredView = drawnKeys.insert(key).second && lastDrawnKeys.count(key) == 0;
+    if (enteredView)
+        stats.lookups++;
+
+    std::unordered_map<std::string, int>::iterator resident = residentCovers.find(key);
+    if (resident != residentCovers.end()) {
+        if (enteredView)
+            stats.hits++;
+        Slot &slot = slots[resident->second];
+        slot.lastUsed = frame;
+        return slot.texture;
+    }
+
+    if (missingCovers.count(key) == 0)
+        Enqueue(key, coverPath, fallbackPath);
+    return 0;
+}
+
+void CoverCache::Prefetch(const std::string &key, const std::string &coverPath, const std::string &fallbackPath) {
+    if (residentCovers.count(key) == 0 && missingCovers.count(key) == 0)
+        Enqueue(key, coverPath, fallbackPath);
+}
+
+void CoverCache::Enqueue(const std::string &key, const std::string &coverPath, const std::string &fallbackPath) {
+    if (!frameRequestKeys.insert(key).second)
+        return;
+
+    Request request;
+    request.key = key;
+    request.coverPath = coverPath;
+    request.fallbackPath = fallbackPath;
+    frameRequests.push_back(request);
+}
+
+void CoverCache::Invalidate(const std::string &key) {
+    missingCovers.erase(key);
+
+    std::unordered_map<std::string, int>::iterator resident = residentCovers.find(key);
+    if (resident != residentCovers.end()) {
+        slots[resident->second].key.clear();
+        residentCovers.erase(resident);
+    }
+}
+
+// a free slot or the one that was drawn the longest time ago, -1 if all of them are on screen
+int CoverCache::FreeSlot() {
+    int oldest = -1;
+    for (int i = 0; i < (int) slots.size(); ++i) {
+        if (slots[i].key.empty())
+            return i;
+        if (slots[i].lastUsed < frame && (oldest < 0 || slots[i].lastUsed < slots[oldest].lastUsed))
+            oldest = i;
+    }
+
+    if (oldest >= 0) {
+        residentCovers.erase(slots[oldest].key);
+        slots[oldest].key.clear();
+        stats.evictions++;
+    }
+    return oldest;
+}
+
+void CoverCache::Update() {
+    std::vector<Result> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // requests that were not repeated this frame scrolled out of view and get dropped
+        pending.clear();
+        for (Request &request : frameRequests)
+            if (request.key != decoding)
+                pending.push_back(request);
+
+        size_t count = std::min(results.size(), (size_t) MAX_UPLOADS_PER_FRAME);
+        finished.assign(std::make_move_iterator(results.begin()), std::make_move_iterator(results.begin() + count));
+        results.erase(results.begin(), results.begin() + count);
+
+        // covers that are already decoded do not need to be requested again
+        for (const Result &result : results)
+            pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                         [&](const Request &request) { return request.key == result.key; }),
+                          pending.end());
+    }
+    condition.notify_all();
+
+    frameRequests.clear();
+    frameRequestKeys.clear();
+    lastDrawnKeys.swap(drawnKeys);
+    drawnKeys.clear();
+
+    for (Result &result : finished) {
+        if (!result.found) {
+            missingCovers.insert(result.key);
+            continue;
+        }
+        if (residentCovers.count(result.key) != 0)
+            continue;
+
+        int slotIndex = FreeSlot();
+        if (slotIndex < 0)
+            continue;
+
+        Slot &slot = slots[slotIndex];
+        glBindTexture(GL_TEXTURE_2D, slot.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, COVER_WIDTH, COVER_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, result.pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        slot.key = result.key;
+        slot.lastUsed = frame;
+        residentCovers[result.key] = slotIndex;
+    }
+
+    frame++;
+}
+
+CoverCache::Stats CoverCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void CoverCache::WorkerThread() {
+    std::vector<uint8_t> image;
+
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (stopping)
+                return;
+
+            request = pending.front();
+            pending.erase(pending.begin());
+            decoding = request.key;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        Result result;
+        result.key = request.key;
+        int width, height;
+        if (ReadPgm(request.coverPath, width, height, image)) {
+            Downscale(image.data(), width, height, result.pixels);
+            result.found = true;
+        } else if (ReadStateImage(request.fallbackPath, image)) {
+            Downscale(image.data(), Emulator::VIDEO_WIDTH, Emulator::VIDEO_HEIGHT, result.pixels);
+            result.found = true;
+        } else {
+            result.found = false;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decoding.clear();
+        results.push_back(std::move(result));
+
+        stats.decodes++;
+        if (!results.back().found)
+            stats.missing++;
+        stats.decodeSeconds += seconds;
+        stats.maxDecodeSeconds = std::max(stats.maxDecodeSeconds, seconds);
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef VB_COVER_CACHE_H
+#define VB_COVER_CACHE_H
+
+#include <GLES3/gl3.h>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Cover images for the rom list. The covers get decoded on a worker thread into a fixed number
+// of small textures, so scrolling through a big list never allocates gpu memory and never waits
+// for the disk. Covers that are not drawn for a while get replaced by the least recently used order.
+class CoverCache {
+public:
+    static const int COVER_WIDTH = 96;
+    static const int COVER_HEIGHT = 56;
+    static const int SLOT_COUNT = 48;
+
+    struct Stats {
+        // rows that came into view and how many of them already had their cover
+        uint32_t lookups;
+        uint32_t hits;
+        uint32_t decodes;
+        uint32_t missing;
+        uint32_t evictions;
+        double decodeSeconds;
+        double maxDecodeSeconds;
+    };
+
+    ~CoverCache();
+
+    // needs the gl context
+    void Init();
+
+    // the texture of the cover or 0 while it is not loaded, requests it if needed
+    GLuint Get(const std::string &key, const std::string &coverPath, const std::string &fallbackPath);
+
+    // requests the cover without it being drawn
+    void Prefetch(const std::string &key, const std::string &coverPath, const std::string &fallbackPath);
+
+    // the cover gets decoded again the next time it is needed
+    void Invalidate(const std::string &key);
+
+    // once per frame on the gl thread, uploads the decoded covers and hands the requests of the frame to the worker
+    void Update();
+
+    Stats GetStats();
+
+private:
+    struct Request {
+        std::string key;
+        std::string coverPath;
+        std::string fallbackPath;
+    };
+
+    struct Result {
+        std::string key;
+        bool found;
+        std::vector<uint32_t> pixels;
+    };
+
+    struct Slot {
+        std::string key;
+        GLuint texture;
+        uint64_t lastUsed;
+    };
+
+    void Enqueue(const std::string &key, const std::string &coverPath, const std::string &fallbackPath);
+
+    int FreeSlot();
+
+    void WorkerThread();
+
+    std::vector<Slot> slots;
+    std::unordered_map<std::string, int> residentCovers;
+    std::unordered_set<std::string> missingCovers;
+    uint64_t frame = 0;
+
+    // covers drawn in this and the last frame, a row only counts as a lookup when it comes into view
+    std::unordered_set<std::string> drawnKeys;
+    std::unordered_set<std::string> lastDrawnKeys;
+
+    // requests of the current frame, visible rows first
+    std::vector<Request> frameRequests;
+    std::unordered_set<std::string> frameRequestKeys;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread worker;
+    bool stopping = false;
+    std::vector<Request> pending;
+    std::string decoding;
+    std::vector<Result> results;
+
+    Stats stats = {};
+};
+
+#endif
@@ -7,8 +7,14 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include <zlib.h>
 #include <VrAppFramework/Include/OVR_Input.h>
 #include <VrApi/Include/VrApi_Input.h>
+#include <VrApi/Include/VrApi_Helpers.h>
 
 #include "Audio/OpenSLWrap.h"
 #include "DrawHelper.h"
@@ -18,6 +24,26 @@
 #include "Global.h"
 
 #include "OvrApp.h"
+#include "PerformanceGovernor.h"
+#include "RunState.h"
+#include "ResumeSnapshot.h"
+#include "FlightRecorder.h"
+#include "Netplay.h"
+#include "MemorySearch.h"
+#include "Cheats.h"
+#include "Capture.h"
+#include "FrameExport.h"
+#include "RomArchive.h"
+#include "RomCache.h"
+#include "RemoteLibrary.h"
+#include "BufferPool.h"
+#include "ScreenLayout.h"
+#include "MemoryTracker.h"
+#include "CoverCache.h"
+#include "RomPatch.h"
+#include "Preloader.h"
+#include "FrameScheduler.h"
+#include "StateFile.h"
 
 template<typename T>
 std::string to_string(T value) {
@@ -49,7 +75,10 @@ void MenuList<Emulator::Rom>::DrawTexture(float offsetX, float offsetY, float tr
                             recHeight,
                             sliderColor, transparency);
 
-    // draw the cartridge icons
+    // covers get tinted like the screen
+    float *color = Emulator::ActiveContext()->color;
+
+    // draw the covers or the cartridge icon for roms without one
     for (uint i = (uint) menuListFState; i < menuListFState + maxListItems; i++) {
         if (i < ItemList->size()) {
             // fading in or out
@@ -61,14 +90,30 @@ void MenuList<Emulator::Rom>::DrawTexture(float offsetX, float offsetY, float tr
                 fadeTransparency = menuListFState - (int) menuListFState;
             }
 
-            DrawHelper::DrawTexture(textureVbIconId,
-                                    PosX + offsetX + scrollbarWidth + 15 - 3
-                                    + (((uint) CurrentSelection == i) ? 5 : 0),
-                                    listStartY + listItemSize / 2 - 12
-                                    + listItemSize * (i - menuListFState) + offsetY, 24, 24,
-                                    {1.0f, 1.0f, 1.0f, 1.0f}, transparency * fadeTransparency);
+            GLuint coverId = Emulator::GetRomCover(ItemList->at(i), true);
+            if (coverId != 0) {
+                DrawHelper::DrawTexture(coverId,
+                                        PosX + offsetX + scrollbarWidth + 15 - 3
+                                        + (((uint) CurrentSelection == i) ? 5 : 0),
+                                        listStartY + listItemSize / 2 - 12
+                                        + listItemSize * (i - menuListFState) + offsetY, 41, 24,
+                                        {color[0], color[1], color[2], 1.0f}, transparency * fadeTransparency);
+            } else {
+                DrawHelper::DrawTexture(textureVbIconId,
+                                        PosX + offsetX + scrollbarWidth + 15 - 3 + 8
+                                        + (((uint) CurrentSelection == i) ? 5 : 0),
+                                        listStartY + listItemSize / 2 - 12
+                                        + listItemSize * (i - menuListFState) + offsetY, 24, 24,
+                                        {1.0f, 1.0f, 1.0f, 1.0f}, transparency * fadeTransparency);
+            }
         }
     }
+
+    // the rows one page above and below get decoded before they scroll into view
+    int prefetchStart = std::max(0, (int) menuListFState - (int) maxListItems);
+    int prefetchEnd = std::min((int) ItemList->size(), (int) menuListFState + 2 * (int) maxListItems);
+    for (int i = prefetchStart; i < prefetchEnd; i++)
+        Emulator::GetRomCover(ItemList->at(i), false);
 }
 
 template<>
@@ -88,7 +133,7 @@ void MenuList<Emulator::Rom>::DrawText(float offsetX, float offsetY, float trans
             FontManager::RenderText(
                     *Font,
                     ItemList->at(i).RomName,
-                    PosX + offsetX + scrollbarWidth + 44 + (((uint) CurrentSelection == i) ? 5 : 0),
+                    PosX + offsetX + scrollbarWidth + 61 + (((uint) CurrentSelection == i) ? 5 : 0),
                     listStartY + itemOffsetY + listItemSize * (i - menuListFState) + offsetY,
                     1.0f,
                     ((uint) CurrentSelection == i) ? textSelectionColor : textColor,
@@ -101,7 +146,7 @@ void MenuList<Emulator::Rom>::DrawText(float offsetX, float offsetY, float trans
 const std::string STR_HEADER = "VirtualBoyGo";
 const std::string STR_VERSION = "ver.1.3";
 const float DisplayRefreshRate = 72.0f;
-const int SAVE_FILE_VERSION = 25;
+const int SAVE_FILE_VERSION = 28;
 
 ovrVector4f headerTextColor = {0.9f, 0.1f, 0.1f, 1.0f};
 ovrVector4f textSelectionColor = {0.9f, 0.1f, 0.1f, 1.0f};
@@ -119,6 +164,10 @@ ovrVector4f MenuBottomColor = {0.25f, 0.25f, 0.25f, 1.0f};
 const ovrJava *java;
 jclass clsData;
 
+OvrApp *appInterface;
+// start of the startup timeline
+double appLaunchTime;
+
 namespace OVR {
 
 #if defined( OVR_OS_ANDROID )
@@ -130,6 +179,7 @@ namespace OVR {
                                                                         jstring fromPackageName,
                                                                         jstring commandString,
                                                                         jstring uriString) {
+        appLaunchTime = SystemClock::GetTimeInSeconds();
 
         jmethodID messageMe = jni->GetMethodID(clazz, "getInternalStorageDir", "()Ljava/lang/String;");
         jobject result = (jstring) jni->CallObjectMethod(activity, messageMe);
@@ -148,7 +198,19 @@ namespace OVR {
         OVR_LOG("got string from java: storageDir %s", storageDir);
 
         OVR_LOG("nativeSetAppInterface");
-        return (new OvrApp())->SetActivity(jni, clazz, activity, fromPackageName, commandString, uriString);
+        appInterface = new OvrApp();
+        return appInterface->SetActivity(jni, clazz, activity, fromPackageName, commandString, uriString);
+    }
+
+    void Java_com_nintendont_virtualboygo_MainActivity_nativeSuspend(JNIEnv *jni, jclass clazz) {
+        OVR_LOG("nativeSuspend");
+        Emulator::SetBackground(true);
+        Emulator::Suspend();
+    }
+
+    void Java_com_nintendont_virtualboygo_MainActivity_nativeResume(JNIEnv *jni, jclass clazz) {
+        OVR_LOG("nativeResume");
+        Emulator::SetBackground(false);
     }
 
     } // extern "C"
@@ -160,6 +222,10 @@ namespace Emulator {
     GLuint screenTextureId, stateImageId;
     GLuint screenTextureCylinderId;
     ovrTextureSwapChain *CylinderSwapChain;
+    // native resolution swap chain used when the upscale pass gets skipped
+    GLuint screenTextureNativeId;
+    ovrTextureSwapChain *CylinderSwapChainNative;
+    GLuint screenShapeIconId;
 
     GlProgram Program;
 
@@ -192,8 +258,6 @@ namespace Emulator {
             "	gl_FragColor = ColorBias + oColor * movieColor;\n"
             "}\n";
 
-    const void *currentScreenData = nullptr;
-
     ovrSurfaceDef ScreenSurfaceDef;
     Bounds3f SceneScreenBounds;
 
@@ -201,6 +265,7 @@ namespace Emulator {
     GlTexture ScreenTexture[2];    // { MovieTexture, Fade Texture }
     Matrix4f ScreenTexMatrix[2];
     GlBuffer ScreenTexMatrices;
+    Matrix4f ScreenModelMatrix;
 
     double startTime;
 
@@ -209,14 +274,10 @@ namespace Emulator {
 
 // 384
 // 768
-    const int VIDEO_WIDTH = 384;
-    const int VIDEO_HEIGHT = 224;
-
     const int CylinderWidth = VIDEO_WIDTH;
     const int CylinderHeight = VIDEO_HEIGHT;
 
     std::string strColor[]{"R: ", "G: ", "B: "};
-    float color[]{1.0f, 1.0f, 1.0f};
     float threedeeIPD = 0;
     float minIPD = -0.1953125f;
     float maxIPD = 0.1953125f;
@@ -250,45 +311,363 @@ namespace Emulator {
     MappedButtons buttonMapping[buttonCount];
     int buttonOrder[14] = {0, 1, 3, 2, 11, 10, 7, 6, 9, 8, 12, 5, 4, 13};
 
-    LoadedGame *currentGame;
+    // state of the instance shown in the headset
+    Context frontendContext;
+    Context *ctx = &frontendContext;
 
     const std::string romFolderPath = "/Roms/VB/";
     const std::string stateFilePath = "/Roms/VB/States/";
 
     std::string stateFolderPath;
 
-    const std::vector<std::string> supportedFileNames = {".vb", ".vboy", ".bin"};
+    const std::vector<std::string> supportedFileNames = {".vb", ".vboy", ".bin", ".zip"};
+
+    // roms extracted from archives
+    const std::string romCacheFolder = "RomCache/";
+    // linked eye buffer program, lives in the app files folder because it belongs to the driver and not to the roms
+    const std::string programCacheFileName = "screen_program.bin";
+    const uint64_t romCacheSize = 64 * 1024 * 1024;
+    RomCache romCache;
+
+    // optional http library, the manifest url is read from library.url in the rom folder
+    const std::string libraryUrlFileName = "library.url";
+    const std::string libraryManifestFileName = "library.manifest";
+    RemoteLibrary::Library remoteLibrary(romCache);
+    bool remoteLibraryOpen = false;
+    int prefetchSelection = -1;
+    // remote rom that gets started once its download finished, the menu stays usable in the meantime
+    RemoteLibrary::Entry launchEntry;
+    bool launchPending = false;
+    uint32_t launchDownloadedBytes;
+
+    // buffers for the rom and state io, reused between loads and saves
+    BufferPool ioBuffers(MemoryTracker::TagStates);
+    // biggest commercial virtual boy rom
+    const size_t romBufferCapacity = 2 * 1024 * 1024;
 
     MenuList<Rom> *romList;
-    std::vector<Rom> *romFileList = new std::vector<Rom>();
+
+    // covers are <rom>.pgm next to the rom, the image of the first save slot is used if there is none
+    const std::string coverFileExtension = ".pgm";
+    CoverCache coverCache;
+    double lastCoverStatsTime;
 
     bool audioInit;
 
     float emulationSpeed = 50.27;
     float frameCounter = 1;
 
-    uint8_t *screenData;
+    // speed multipliers for the fast forward modes; 0 runs as many frames as fit into the frame budget
+    const int FAST_FORWARD_MODE_COUNT = 4;
+    const int fastForwardSpeeds[] = {1, 2, 4, 0};
+    std::string strFastForward[] = {"Off", "2x", "4x", "Uncapped"};
+    int fastForwardMode = 0;
+    // part of a display frame the core is allowed to use while running uncapped
+    const double uncappedFrameBudget = 0.6 / DisplayRefreshRate;
+
+    bool skipVideoFrame;
+    // the flight recorder can replay the frames since power on as long as the game was only played
+    bool replayableRun;
+    float audioCredit;
+
+    // the speed only gets measured while playing, the menu shows the one of the last play period
+    int measuredFrames;
+    double speedMeasureStart;
+    float achievedSpeed = 1;
+    // shorter rests of a measurement window are too noisy to show
+    const double minSpeedMeasureTime = 0.25;
+
+    const char *thermalZonePath = "/sys/class/thermal/thermal_zone0/temp";
+    PerformanceGovernor::Config governorConfig;
+    PerformanceGovernor::State governorState;
+    bool skipUpscale;
+    bool forceMono;
+    bool frameskip;
+    int videoFrameCount;
+
+    // the core only runs while playing, the other states keep showing the last frame at minimum clocks
+    RunState::Tracker runState;
+    std::atomic<bool> appInBackground(false);
+    const double runStateReportWindow = 60;
 
     int screenPosY;
 
-    int screenborder = 1;
-    int TextureHeight = VIDEO_HEIGHT * 2 + 1 * 2;//12;
+    int screenborder = ScreenLayout::STACKED_BORDER;
+    int TextureHeight = ScreenLayout::Size<ScreenLayout::Stacked>::height;
 
-    int32_t *pixelData = new int32_t[VIDEO_WIDTH * TextureHeight];
+    // color of every intensity for the current palette color
+    uint32_t paletteLut[256];
+    float paletteLutColor[3] = {-1, -1, -1};
 
-    int32_t *stateImageData = new int32_t[VIDEO_WIDTH * VIDEO_HEIGHT];
+    // memory readout drawn into the game image while playing, off by default
+    bool memoryOverlay = false;
+    const int OVERLAY_SCALE = 2;
+    // 3x5 glyphs, the top row is in the highest bits
+    const char overlayGlyphNames[] = "0123456789.MEGPUB";
+    const uint16_t overlayGlyphs[] = {
+            0b111101101101111, 0b010110010010111, 0b111001111100111, 0b111001111001111, 0b101101111001001,
+            0b111100111001111, 0b111100111101111, 0b111001001001001, 0b111101111101111, 0b111101111001111,
+            0b000000000000010, 0b101111111101101, 0b111100111100111, 0b111100101101111, 0b111101111100100,
+            0b101101101101111, 0b110101110101110};
 
-    bool useCubeMap = false;
+    int32_t *stateImageData = new int32_t[VIDEO_WIDTH * VIDEO_HEIGHT];
+    // rows of the slot image that get converted and uploaded per frame
+    const int stateImageChunkRows = VIDEO_HEIGHT / 4;
+
+    // menu work runs in the part of the frame the emulation did not use
+    FrameScheduler frameScheduler;
+    const float schedulerFrameShare = 0.5f;
+    double updateStartTime;
+
+    // frame cost statistics of the idle and the playing frames, used to see the effect of the scheduler
+    struct FrameCostStats {
+        uint32_t frames;
+        double sum;
+        double squareSum;
+        double max;
+    };
+    FrameCostStats frameCostStats[2];
+    double frameCostStatsStart;
+
+    // the cylinder layer gets composited by the runtime, the other two get drawn into the eye buffers
+    enum ScreenShape {
+        ScreenCylinderLayer, ScreenFlat, ScreenCurved, SCREEN_SHAPE_COUNT
+    };
+    const char *screenShapeNames[SCREEN_SHAPE_COUNT] = {"Cylinder Layer", "Flat Screen", "Curved Screen"};
+    // columns of the curved mesh; the flat screen only needs one
+    const int SCREEN_MESH_DETAIL_COUNT = 4;
+    const int screenMeshColumnOptions[SCREEN_MESH_DETAIL_COUNT] = {12, 24, 48, 96};
+    const char *screenMeshDetailNames[SCREEN_MESH_DETAIL_COUNT] = {"Low", "Medium", "High", "Very High"};
+    int screenMeshDetail = 2;
+
+    int screenShape = ScreenCylinderLayer;
     bool useThreeDeeMode = true;
+    // mode and height the screen textures are currently allocated for
+    bool monoScreen;
+    int screenHeight = TextureHeight;
+
+    bool screenSurfaceInit;
+    int screenMeshShape = -1;
+    int screenMeshColumns = 0;
+
+    // the texture matrices only get uploaded when one of these changes
+    struct ScreenUniformKey {
+        bool valid;
+        bool mono;
+        bool stereo;
+        float ipd;
+    };
+    ScreenUniformKey screenUniformKey;
+    uint32_t screenUniformUploads;
+    bool firstFramePresented;
+
+    const std::string resumeFileName = "resume.snapshot";
+
+    // the snapshot can get requested from the java thread while the core is running
+    std::mutex coreMutex;
+    std::atomic<bool> snapshotWriting(false);
+    bool headsetMounted = true;
+
+    Rom resumeRom;
+
+    // a patch with the name of the rom gets applied when loading it
+    const std::vector<std::string> patchFileExtensions = {".bps", ".ips"};
+    // copy of the list entry with the patch and the saves of the patched rom
+    Rom patchedRom;
+
+    // the rom the cursor rests on gets loaded in the background so starting it only has to swap in the data
+    const double preloadDwellTime = 0.4;
+    // the biggest rom, its save ram and all slot images
+    Preloader preloader(4 * 1024 * 1024);
+    int preloadSelection = -1;
+    double preloadSelectionTime;
+    uint32_t preloadHits, preloadMisses;
+    double preloadHitLaunchTime, preloadMissLaunchTime;
+    std::vector<uint8_t> resumeFrame;
+    bool resumeMenuClose;
+    std::thread slotThread;
+    std::atomic<bool> slotsLoaded(false);
+    // needs to get increased when the core changes the layout of its states
+    const uint32_t STATE_CORE_VERSION = 1;
+    std::thread slotValidationThread;
+    std::atomic<bool> slotsValidated(false);
+    std::vector<StateFile::Status> slotStatus;
+    StateFile::Stats slotValidationStats;
+    // the last saved state gets written and synced here, everything that reads the state files waits for it
+    std::thread stateWriteThread;
+    double slotValidationTime;
+    // the result of the validation is older than the slots saved while it was running
+    bool slotSavedDuringValidation[10];
+
+    Netplay::Session *netplaySession;
+    Netplay::SyncState netplaySyncState;
+    // the guest plays with the save ram of the host, it must not end up in the save file of the guest
+    bool ramFromNetplayHost;
+    bool netplayResimulating;
+    // optional udp netplay, "<local port> <remote ip> <remote port>" is read from netplay.cfg in the rom folder
+    const std::string netplayConfigFileName = "netplay.cfg";
+    bool netplayConfigured = false;
+    int netplayLocalPort, netplayRemotePort;
+    std::string netplayRemoteHost;
+    std::unique_ptr<Netplay::UdpTransport> netplayTransport;
+
+    // ram search and the cheats of the current rom
+    MemorySearch::Search memorySearch;
+    MemorySearch::Compare searchCompare = MemorySearch::CompareChanged;
+    Cheats::CheatList cheatList;
+    // only a search narrowed down this far gets turned into cheats
+    const size_t MAX_CHEAT_CANDIDATES = 8;
+
+    Capture::Recorder recorder;
+
+    // frames for local viewers, off by default
+    FrameExport::Publisher framePublisher;
 
-    Rom *CurrentRom;
     GLuint screenFramebuffer[2];
     int romSelection = 0;
 
     MenuButton *rButton, *gButton, *bButton;
+    MenuButton *searchButton, *cheatButton;
+    MenuButton *recordButton;
 
     void LoadRam();
 
+    void LoadSlots();
+
+    void LoadCheats();
+
+    void StopRecording();
+
+    Matrix4f ScreenMatrix();
+
+    void RecordIo(FlightRecorder::IoType type, size_t bytes, double ioStartTime) {
+        FlightRecorder::RecordIo(type, (uint32_t) bytes, (uint32_t) ((SystemClock::GetTimeInSeconds() - ioStartTime) * 1000000));
+    }
+
+    void LogStartup(const char *step) {
+        OVR_LOG("startup %s: %.1fms", step, (SystemClock::GetTimeInSeconds() - appLaunchTime) * 1000);
+    }
+
+    void UpdateScreen(const void *data);
+
+    // gpu memory of the screen textures for the current mode
+    size_t screenTextureBytes;
+
+    void DeleteScreenTextures() {
+        MemoryTracker::Freed(MemoryTracker::TagGpu, screenTextureBytes);
+        glDeleteFramebuffers(1, &screenFramebuffer[0]);
+        glDeleteTextures(1, &screenTextureId);
+        vrapi_DestroyTextureSwapChain(CylinderSwapChain);
+        vrapi_DestroyTextureSwapChain(CylinderSwapChainNative);
+        CylinderSwapChain = nullptr;
+    }
+
+    // creates the textures for the current screen mode; mono only needs half the height
+    void CreateScreenTextures() {
+        if (CylinderSwapChain != nullptr)
+            DeleteScreenTextures();
+
+        monoScreen = !useThreeDeeMode || forceMono;
+        screenHeight = monoScreen ? VIDEO_HEIGHT : TextureHeight;
+        OVR_LOG("create screen textures %i, %i", CylinderWidth, screenHeight);
+
+        GLfloat borderColor[] = {1.0f, 0.0f, 0.0f, 1.0f};
+
+        glGenTextures(1, &screenTextureId);
+        glBindTexture(GL_TEXTURE_2D, screenTextureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, VIDEO_WIDTH, screenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        {
+            int borderSize = screenborder;
+            // left texture
+            CylinderSwapChain =
+                    vrapi_CreateTextureSwapChain(VRAPI_TEXTURE_TYPE_2D, VRAPI_TEXTURE_FORMAT_8888_sRGB, CylinderWidth * 2 + borderSize * 2,
+                                                 screenHeight * 2 + borderSize * 2, 1, false);
+            screenTextureCylinderId = vrapi_GetTextureSwapChainHandle(CylinderSwapChain, 0);
+            glBindTexture(GL_TEXTURE_2D, screenTextureCylinderId);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CylinderWidth * 2 + borderSize * 2, screenHeight * 2 + borderSize * 2, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            //glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // create the framebuffer for the screen texture
+            glGenFramebuffers(1, &screenFramebuffer[0]);
+            glBindFramebuffer(GL_FRAMEBUFFER, screenFramebuffer[0]);
+            // Set "renderedTexture" as our colour attachement #0
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTextureCylinderId, 0);
+            // Set the list of draw buffers.
+            GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+            glDrawBuffers(1, DrawBuffers);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            CylinderSwapChainNative =
+                    vrapi_CreateTextureSwapChain(VRAPI_TEXTURE_TYPE_2D, VRAPI_TEXTURE_FORMAT_8888_sRGB, CylinderWidth, screenHeight, 1, false);
+            screenTextureNativeId = vrapi_GetTextureSwapChainHandle(CylinderSwapChainNative, 0);
+            glBindTexture(GL_TEXTURE_2D, screenTextureNativeId);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // source texture, upscaled swap chain and native swap chain, all rgba
+            screenTextureBytes = (size_t) (VIDEO_WIDTH * screenHeight * 4 +
+                                           (CylinderWidth * 2 + borderSize * 2) * (screenHeight * 2 + borderSize * 2) * 4 +
+                                           CylinderWidth * screenHeight * 4);
+            MemoryTracker::Allocated(MemoryTracker::TagGpu, screenTextureBytes);
+        }
+    }
+
+    // the native swap chain holds both eyes stacked without the border and the 2x scale of the upscaled
+    // one, so the texture matrices the layer builder made for that one do not fit
+    ovrMatrix4f NativeEyeMatrix(int eye, bool stereo) {
+        ovrMatrix4f matrix = ovrMatrix4f_CreateIdentity();
+        matrix.M[1][1] = (float) VIDEO_HEIGHT / screenHeight;
+        if (eye == 1 && stereo)
+            matrix.M[1][2] = (float) (VIDEO_HEIGHT + ScreenLayout::STACKED_BORDER * 2) / screenHeight;
+        return matrix;
+    }
+
+    // recreate the screen textures if the mode does not match the allocated ones anymore
+    void UpdateScreenMode() {
+        if (CylinderSwapChain == nullptr || monoScreen == (!useThreeDeeMode || forceMono))
+            return;
+
+        CreateScreenTextures();
+    }
+
+    // the screen shape buttons get their own icon: the outline of a screen that bends towards the viewer
+    void InitScreenShapeIcon() {
+        const int iconSize = 28;
+        uint32_t pixels[iconSize * iconSize] = {};
+        for (int x = 3; x < iconSize - 3; ++x) {
+            float u = (x - (iconSize - 1) * 0.5f) / ((iconSize - 7) * 0.5f);
+            int bend = (int) (u * u * 3 + 0.5f);
+            int top = 8 - bend, bottom = iconSize - 9 + bend;
+            bool side = x < 5 || x >= iconSize - 5;
+            for (int y = top; y <= bottom; ++y) {
+                if (side || y < top + 2 || y > bottom - 2)
+                    pixels[x + y * iconSize] = 0xFFFFFFFF;
+            }
+        }
+
+        glGenTextures(1, &screenShapeIconId);
+        glBindTexture(GL_TEXTURE_2D, screenShapeIconId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, iconSize, iconSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
     void InitStateImage() {
         glGenTextures(1, &stateImageId);
         glBindTexture(GL_TEXTURE_2D, stateImageId);
@@ -298,53 +677,125 @@ namespace Emulator {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glBindTexture(GL_TEXTURE_2D, 0);
+        MemoryTracker::Allocated(MemoryTracker::TagGpu, VIDEO_WIDTH * VIDEO_HEIGHT * 4);
     }
 
-    void UpdateStateImage(int saveSlot) {
-        glBindTexture(GL_TEXTURE_2D, stateImageId);
+    // the slots of a resumed game get loaded in the background, everything touching them has to wait for it
+    void WaitForSlots() {
+        if (slotThread.joinable())
+            slotThread.join();
+    }
 
-        uint8_t *dataArray = currentGame->saveStates[saveSlot].saveImage;
-        for (int y = 0; y < VIDEO_HEIGHT; ++y) {
-            for (int x = 0; x < VIDEO_WIDTH; ++x) {
-                uint8_t das = dataArray[x + y * VIDEO_WIDTH];
-                stateImageData[x + y * VIDEO_WIDTH] =
-                        0xFF000000 | ((int) (das * color[2]) << 16) | ((int) (das * color[1]) << 8) | (int) (das * color[0]);
-            }
+    void WaitForStateWrite() {
+        if (stateWriteThread.joinable())
+            stateWriteThread.join();
+    }
+
+    // the palette follows the color settings, the screen and the slot image both convert through it
+    void UpdatePalette() {
+        if (memcmp(paletteLutColor, ctx->color, sizeof(paletteLutColor)) != 0) {
+            memcpy(paletteLutColor, ctx->color, sizeof(paletteLutColor));
+            ScreenLayout::BuildPalette(ctx->color, paletteLut);
         }
+    }
 
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, VIDEO_WIDTH, VIDEO_HEIGHT, GL_RGBA,
+    // converts and uploads the rows starting at startY, returns true after the last row
+    bool UpdateStateImageRows(int saveSlot, int startY, int rowCount) {
+        WaitForSlots();
+        int endY = std::min(startY + rowCount, VIDEO_HEIGHT);
+        glBindTexture(GL_TEXTURE_2D, stateImageId);
+
+        UpdatePalette();
+        uint8_t *dataArray = ctx->currentGame->saveStates[saveSlot].saveImage;
+        for (int y = startY; y < endY; ++y)
+            ScreenLayout::ConvertRow(dataArray + y * VIDEO_WIDTH, (uint32_t *) stateImageData + y * VIDEO_WIDTH, paletteLut);
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, startY, VIDEO_WIDTH, endY - startY, GL_RGBA,
                         GL_UNSIGNED_BYTE,
-                        stateImageData);
+                        stateImageData + startY * VIDEO_WIDTH);
         glBindTexture(GL_TEXTURE_2D, 0);
+        return endY == VIDEO_HEIGHT;
     }
 
-    void UpdateScreen(const void *data) {
-        screenData = (uint8_t *) data;
-        uint8_t *dataArray = (uint8_t *) data;
+    // the image gets converted over a few frames, a newer request for another slot or color restarts it
+    void UpdateStateImage(int saveSlot) {
+        int startY = 0;
+        frameScheduler.Post("state image", FrameScheduler::PriorityNormal, [saveSlot, startY]() mutable {
+            bool done = UpdateStateImageRows(saveSlot, startY, stateImageChunkRows);
+            startY += stateImageChunkRows;
+            return done;
+        });
+    }
 
-        {
-            for (int y = 0; y < VIDEO_HEIGHT; ++y) {
-                for (int x = 0; x < VIDEO_WIDTH; ++x) {
-                    uint8_t das = dataArray[x + y * VIDEO_WIDTH];
-                    pixelData[x + y * VIDEO_WIDTH] =
-                            0xFF000000 | ((int) (das * color[2]) << 16) | ((int) (das * color[1]) << 8) | (int) (das * color[0]);
-                }
+    // white text on a black box with its top left corner at x, y; unknown characters are left empty
+    void DrawOverlayText(uint32_t *image, int x, int y, const char *text) {
+        const int advance = 4 * OVERLAY_SCALE;
+        const int boxWidth = std::min((int) strlen(text) * advance + OVERLAY_SCALE * 2, VIDEO_WIDTH - x);
+        const int boxHeight = 7 * OVERLAY_SCALE;
+        for (int row = 0; row < boxHeight; ++row)
+            std::fill_n(image + (y + row) * VIDEO_WIDTH + x, boxWidth, 0xFF000000);
+
+        for (int i = 0; text[i] && (i + 1) * advance <= boxWidth; ++i) {
+            const char *name = strchr(overlayGlyphNames, text[i]);
+            if (text[i] == ' ' || !name)
+                continue;
+            uint16_t glyph = overlayGlyphs[name - overlayGlyphNames];
+            for (int bit = 0; bit < 15; ++bit) {
+                if (!(glyph & (1 << (14 - bit))))
+                    continue;
+                int pixelX = x + OVERLAY_SCALE * (2 + i * 4 + bit % 3);
+                int pixelY = y + OVERLAY_SCALE * (1 + bit / 3);
+                for (int row = 0; row < OVERLAY_SCALE; ++row)
+                    std::fill_n(image + (pixelY + row) * VIDEO_WIDTH + pixelX, OVERLAY_SCALE, 0xFFFFFFFF);
             }
+        }
+    }
 
-            for (int y = 0; y < VIDEO_HEIGHT; ++y) {
-                for (int x = 0; x < VIDEO_WIDTH; ++x) {
-                    uint8_t das = dataArray[x + (y + VIDEO_HEIGHT + 12) * VIDEO_WIDTH];
-                    pixelData[x + (y + VIDEO_HEIGHT + screenborder * 2) * VIDEO_WIDTH] =
-                            0xFF000000 | ((int) (das * color[2]) << 16) | ((int) (das * color[1]) << 8) | (int) (das * color[0]);
-                }
-            }
+    // the same numbers as the summary in the main menu; both eyes get it at the same spot so it sits on the screen
+    void DrawMemoryOverlay(uint32_t *image) {
+        int64_t memoryBytes = 0;
+        for (int i = 0; i < MemoryTracker::TAG_COUNT; ++i)
+            if (i != MemoryTracker::TagGpu)
+                memoryBytes += MemoryTracker::GetStats((MemoryTracker::Tag) i).bytes;
+        int64_t gpuBytes = MemoryTracker::GetStats(MemoryTracker::TagGpu).bytes;
+
+        char text[32];
+        snprintf(text, sizeof(text), "MEM %.1fMB GPU %.1fMB", memoryBytes / (1024.0 * 1024.0), gpuBytes / (1024.0 * 1024.0));
+        DrawOverlayText(image, 4, 4, text);
+        if (!monoScreen)
+            DrawOverlayText(image, 4, VIDEO_HEIGHT + ScreenLayout::STACKED_BORDER * 2 + 4, text);
+    }
+
+    void UpdateScreen(const void *data) {
+        ctx->screenData = (uint8_t *) data;
 
-            // make the space between the two images transparent
-            memset(&pixelData[VIDEO_WIDTH * VIDEO_HEIGHT], 0x00000000, screenborder * 1 * VIDEO_WIDTH * 4);
-            memset(&pixelData[VIDEO_WIDTH * VIDEO_HEIGHT + VIDEO_WIDTH], 0x00000000, screenborder * 1 * VIDEO_WIDTH * 4);
+        RunState::Counters &counters = RunState::Current(runState);
+        counters.framesUploaded++;
+        counters.bytesUploaded += CylinderWidth * screenHeight * 4;
+
+        {
+            UpdatePalette();
+
+            // in mono mode only the left eye gets converted and uploaded
+            if (monoScreen)
+                ScreenLayout::Convert<ScreenLayout::Mono>((const uint8_t *) data, (uint32_t *) ctx->pixelData, paletteLut);
+            else
+                ScreenLayout::Convert<ScreenLayout::Stacked>((const uint8_t *) data, (uint32_t *) ctx->pixelData, paletteLut);
+            if (memoryOverlay)
+                DrawMemoryOverlay((uint32_t *) ctx->pixelData);
+
+            if (skipUpscale) {
+                // upload straight into the native resolution swap chain, the eye buffer surface samples it as well
+                glBindTexture(GL_TEXTURE_2D, screenTextureNativeId);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CylinderWidth, screenHeight, GL_RGBA, GL_UNSIGNED_BYTE, ctx->pixelData);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                ScreenTexture[0] = GlTexture(screenTextureNativeId, GL_TEXTURE_2D, CylinderWidth, screenHeight);
+                ScreenTexture[1] = GlTexture(screenTextureNativeId, GL_TEXTURE_2D, CylinderWidth, screenHeight);
+                return;
+            }
 
             glBindTexture(GL_TEXTURE_2D, screenTextureId);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CylinderWidth, TextureHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixelData);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CylinderWidth, screenHeight, GL_RGBA, GL_UNSIGNED_BYTE, ctx->pixelData);
             glBindTexture(GL_TEXTURE_2D, 0);
 
             glDisable(GL_CULL_FACE);
@@ -354,7 +805,7 @@ namespace Emulator {
             glBlendEquation(GL_FUNC_ADD);
             // render image to the screen texture
             glBindFramebuffer(GL_FRAMEBUFFER, screenFramebuffer[0]);
-            glViewport(0, 0, VIDEO_WIDTH * 2 + screenborder * 2, TextureHeight * 2 + screenborder * 4);
+            glViewport(0, 0, VIDEO_WIDTH * 2 + screenborder * 2, screenHeight * 2 + screenborder * 4);
             glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
             glClear(GL_COLOR_BUFFER_BIT);
 
@@ -363,79 +814,171 @@ namespace Emulator {
             // TODO use 6px border
             DrawHelper::DrawTexture(screenTextureId,
                                     640 * ((float) screenborder * 2 / (VIDEO_WIDTH * 2 + screenborder * 4)),
-                                    576 * ((float) screenborder * 2 / (TextureHeight * 2 + screenborder * 4)),
+                                    576 * ((float) screenborder * 2 / (screenHeight * 2 + screenborder * 4)),
                                     640 * ((float) (VIDEO_WIDTH * 2) / (VIDEO_WIDTH * 2 + screenborder * 4)),
-                                    576 * ((float) (TextureHeight * 2) / (TextureHeight * 2 + screenborder * 4)),
+                                    576 * ((float) (screenHeight * 2) / (screenHeight * 2 + screenborder * 4)),
                                     {1.0f, 1.0f, 1.0f, 1.0f}, 1);
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
 
         // TODO whut
         ScreenTexture[0] = GlTexture(screenTextureCylinderId, GL_TEXTURE_2D,
-                                     VIDEO_WIDTH * 2 + screenborder * 4, TextureHeight * 2 + screenborder * 4);
+                                     VIDEO_WIDTH * 2 + screenborder * 4, screenHeight * 2 + screenborder * 4);
         ScreenTexture[1] = GlTexture(screenTextureCylinderId, GL_TEXTURE_2D,
-                                     VIDEO_WIDTH * 2 + screenborder * 4, TextureHeight * 2 + screenborder * 4);
+                                     VIDEO_WIDTH * 2 + screenborder * 4, screenHeight * 2 + screenborder * 4);
 
     }
 
+    // netplay always runs at normal speed
+    int CurrentSpeed() {
+        return netplaySession ? 1 : fastForwardSpeeds[fastForwardMode];
+    }
+
     void AudioFrame(unsigned short *audio, int32_t sampleCount) {
+        // resimulated frames were already played
+        if (netplayResimulating)
+            return;
+
+        // while fast forwarding only every n-th frame gets played; uncapped is muted
+        int speed = CurrentSpeed();
+        if (speed != 1) {
+            if (speed == 0)
+                return;
+            audioCredit += 1.0f / speed;
+            if (audioCredit < 1)
+                return;
+            audioCredit -= 1;
+        }
+
         if (!audioInit) {
             audioInit = true;
             StartPlaying();
         }
 
         SetBuffer(audio, (unsigned) (sampleCount * 2));
+        RunState::Current(runState).audioFrames++;
         // 52602
         // 877
         // OVR_LOG("VRVB audio size: %i", sampleCount);
     }
 
-    void VB_Audio_CB(int16_t *SoundBuf, int32_t SoundBufSize) {
+    void VB_Audio_CB(Context &context, int16_t *SoundBuf, int32_t SoundBufSize) {
+        if (recorder.IsRecording() && !netplayResimulating)
+            recorder.PushAudio(SoundBuf, SoundBufSize);
         AudioFrame((unsigned short *) SoundBuf, SoundBufSize);
     }
 
-    void VB_VIDEO_CB(const void *data, unsigned width, unsigned height) {
+    void VB_VIDEO_CB(Context &context, const void *data, unsigned width, unsigned height) {
         // OVR_LOG("VRVB width: %i, height: %i, %i", width, height, (((int8_t *) data)[5])); // 144 + 31 * 384
         // update the screen texture with the newly received image
-        currentScreenData = data;
+        context.currentScreenData = data;
+        // every emulated frame gets recorded, also the ones that are not shown
+        if (recorder.IsRecording() && !netplayResimulating)
+            recorder.PushFrame((const uint8_t *) data);
+        if (framePublisher.IsOpen() && !netplayResimulating)
+            framePublisher.Publish((const uint8_t *) data, context.emulatedFrame, VRVB::input_buf[0]);
+        // frames that will never be presented do not need to get converted and uploaded
+        if (skipVideoFrame || (frameskip && (++videoFrameCount & 1)))
+            return;
         UpdateScreen(data);
     }
 
+    // the first slot has no number
+    std::string SlotPath(const std::string &romName, const char *extension, int slot) {
+        std::string path = stateFolderPath + romName + extension;
+        if (slot > 0) path += to_string(slot);
+        return path;
+    }
+
     bool StateExists(int slot) {
-        std::string savePath = stateFolderPath + CurrentRom->RomName + ".state";
-        if (slot > 0) savePath += to_string(slot);
+        std::string savePath = SlotPath(ctx->CurrentRom->RomName, ".state", slot);
         struct stat buffer;
         return (stat(savePath.c_str(), &buffer) == 0);
     }
 
+    StateFile::Identity StateIdentity() {
+        StateFile::Identity identity;
+        identity.coreVersion = STATE_CORE_VERSION;
+        identity.romHash = ctx->currentRomHash;
+        identity.stateSize = (uint32_t) VRVB::retro_serialize_size();
+        return identity;
+    }
+
+    // checks the states of the current rom in the background, the menu marks the broken slots once it is done
+    void ValidateSlots() {
+        if (slotValidationThread.joinable())
+            slotValidationThread.join();
+        WaitForStateWrite();
+        slotsValidated = false;
+
+        for (int i = 0; i < 10; ++i) {
+            ctx->currentGame->saveStates[i].stateBroken = false;
+            slotSavedDuringValidation[i] = false;
+        }
+        if (ctx->CurrentRom == nullptr)
+            return;
+
+        std::vector<std::string> slotPaths;
+        for (int i = 0; i < 10; ++i)
+            slotPaths.push_back(SlotPath(ctx->CurrentRom->RomName, ".state", i));
+        std::string indexPath = stateFolderPath + ctx->CurrentRom->RomName + ".stateidx";
+        StateFile::Identity identity = StateIdentity();
+
+        slotValidationThread = std::thread([slotPaths, indexPath, identity]() {
+            FlightRecorder::InstallThread();
+            double validationStartTime = SystemClock::GetTimeInSeconds();
+            slotValidationStats = StateFile::Stats();
+            StateFile::ValidateSlots(slotPaths, indexPath, identity, slotStatus, slotValidationStats);
+            slotValidationTime = SystemClock::GetTimeInSeconds() - validationStartTime;
+            slotsValidated = true;
+        });
+    }
+
+    void UpdateSlotValidation() {
+        if (!slotsValidated.exchange(false))
+            return;
+        slotValidationThread.join();
+
+        int brokenCount = 0;
+        for (int i = 0; i < 10; ++i) {
+            if (slotSavedDuringValidation[i])
+                continue;
+            ctx->currentGame->saveStates[i].stateBroken = slotStatus[i] == StateFile::StatusBroken ||
+                                                          slotStatus[i] == StateFile::StatusMismatch;
+            if (ctx->currentGame->saveStates[i].stateBroken) {
+                OVR_LOG("slot %i is %s", i, StateFile::Name(slotStatus[i]));
+                brokenCount++;
+            }
+        }
+
+        OVR_LOG("validated slots in %.1fms: %u checked (%llu bytes), %u from the index, %i broken", slotValidationTime * 1000,
+                slotValidationStats.verified, (unsigned long long) slotValidationStats.bytesRead, slotValidationStats.fromIndex,
+                brokenCount);
+    }
+
     void SaveStateImage(int slot) {
-        std::string savePath = stateFolderPath + CurrentRom->RomName + ".stateimg";
-        if (slot > 0) savePath += to_string(slot);
+        std::string savePath = SlotPath(ctx->CurrentRom->RomName, ".stateimg", slot);
 
         OVR_LOG("save image of slot to %s", savePath.c_str());
+        double ioStartTime = SystemClock::GetTimeInSeconds();
         std::ofstream outfile(savePath, std::ios::trunc | std::ios::binary);
-        outfile.write((const char *) currentGame->saveStates[slot].saveImage,
+        outfile.write((const char *) ctx->currentGame->saveStates[slot].saveImage,
                       sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
         outfile.close();
+        RecordIo(FlightRecorder::IoSaveStateImage, VIDEO_WIDTH * VIDEO_HEIGHT, ioStartTime);
         OVR_LOG("finished writing save image to file");
     }
 
     bool LoadStateImage(int slot) {
-        std::string savePath = stateFolderPath + CurrentRom->RomName + ".stateimg";
-        if (slot > 0) savePath += to_string(slot);
+        std::string savePath = SlotPath(ctx->CurrentRom->RomName, ".stateimg", slot);
 
-        std::ifstream file(savePath, std::ios::in | std::ios::binary | std::ios::ate);
+        double ioStartTime = SystemClock::GetTimeInSeconds();
+        std::ifstream file(savePath, std::ios::in | std::ios::binary);
         if (file.is_open()) {
-            uint8_t *data = new uint8_t[VIDEO_WIDTH * VIDEO_HEIGHT];
-            file.seekg(0, std::ios::beg);
-            file.read((char *) data, sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
+            file.read((char *) ctx->currentGame->saveStates[slot].saveImage, sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
             file.close();
 
-            memcpy(currentGame->saveStates[slot].saveImage, data,
-                   sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
-
-            delete[] data;
-
+            RecordIo(FlightRecorder::IoLoadStateImage, VIDEO_WIDTH * VIDEO_HEIGHT, ioStartTime);
             OVR_LOG("loaded image file: %s", savePath.c_str());
 
             return true;
@@ -445,124 +988,497 @@ namespace Emulator {
         return false;
     }
 
+    // roms inside of archives only get extracted the first time, after that they come from the cache
+    bool ReadRomFile(const Rom &rom, std::vector<uint8_t> &data) {
+        if (RemoteLibrary::IsRemote(rom.FullPath)) {
+            RemoteLibrary::Entry remoteEntry;
+            if (!remoteLibrary.Find(rom.FullPath, remoteEntry)) {
+                OVR_LOG("rom is not in the remote library: %s", rom.FullPath.c_str());
+                return false;
+            }
+
+            double downloadStartTime = SystemClock::GetTimeInSeconds();
+            if (!remoteLibrary.Fetch(remoteEntry, data)) {
+                OVR_LOG("could not download %s", rom.FullPath.c_str());
+                return false;
+            }
+            OVR_LOG("got %s in %.1fms", rom.FullPath.c_str(), (SystemClock::GetTimeInSeconds() - downloadStartTime) * 1000);
+            return true;
+        }
+
+        if (rom.ArchiveEntry.empty()) {
+            std::ifstream file(rom.FullPath, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+                return false;
+
+            data.resize((size_t) file.tellg());
+            file.seekg(0, std::ios::beg);
+            file.read((char *) data.data(), data.size());
+            return !file.fail();
+        }
+
+        RomArchive::Entry entry;
+        if (!RomArchive::FindEntry(rom.FullPath, rom.ArchiveEntry, entry)) {
+            OVR_LOG("could not find %s in %s", rom.ArchiveEntry.c_str(), rom.FullPath.c_str());
+            return false;
+        }
+
+        if (romCache.Get(entry.crc, entry.size, data))
+            return true;
+
+        double extractStartTime = SystemClock::GetTimeInSeconds();
+        if (!RomArchive::Extract(rom.FullPath, entry, data)) {
+            OVR_LOG("could not extract %s from %s", rom.ArchiveEntry.c_str(), rom.FullPath.c_str());
+            return false;
+        }
+        OVR_LOG("extracted %s in %.1fms", rom.ArchiveEntry.c_str(), (SystemClock::GetTimeInSeconds() - extractStartTime) * 1000);
+
+        romCache.Put(entry.crc, data);
+        return true;
+    }
+
+    // the patched rom is cached under the crc of the rom and the patch, so the patch only gets applied once
+    bool PatchRomData(const Rom &rom, std::vector<uint8_t> &data) {
+        uint32_t patchCrc;
+        if (!RomPatch::Checksum(rom.PatchPath, patchCrc)) {
+            OVR_LOG("could not read patch %s", rom.PatchPath.c_str());
+            return false;
+        }
+
+        uint64_t key = ((uint64_t) crc32(0, data.data(), (uInt) data.size()) << 32) | patchCrc;
+        BufferPool::Buffer scratch = ioBuffers.Acquire(romBufferCapacity);
+        uint32_t patchedCrc, patchedSize;
+        if (romCache.GetAlias(key, patchedCrc, patchedSize) && romCache.Get(patchedCrc, patchedSize, *scratch)) {
+            data.swap(*scratch);
+            return true;
+        }
+
+        double patchStartTime = SystemClock::GetTimeInSeconds();
+        if (!RomPatch::Apply(rom.PatchPath, data, *scratch)) {
+            OVR_LOG("could not apply patch %s", rom.PatchPath.c_str());
+            return false;
+        }
+        OVR_LOG("applied %s in %.1fms", rom.PatchPath.c_str(), (SystemClock::GetTimeInSeconds() - patchStartTime) * 1000);
+
+        patchedCrc = (uint32_t) crc32(0, data.data(), (uInt) data.size());
+        romCache.Put(patchedCrc, data);
+        romCache.PutAlias(key, patchedCrc, (uint32_t) data.size());
+        return true;
+    }
+
+    bool ReadRomData(const Rom &rom, std::vector<uint8_t> &data) {
+        if (!ReadRomFile(rom, data))
+            return false;
+        return rom.PatchPath.empty() || PatchRomData(rom, data);
+    }
+
+    std::string FindPatch(const Rom &rom) {
+        for (const std::string &extension : patchFileExtensions) {
+            std::string path = rom.FullPathNorm + extension;
+            if (RomPatch::Detect(path) != RomPatch::FormatNone)
+                return path;
+        }
+        return "";
+    }
+
+    // the patched rom gets its own save ram, states and cheats
+    void SetPatchedIdentity(Rom &rom, uint32_t romHash) {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), " [%08x]", romHash);
+        rom.RomName += suffix;
+        rom.SavePath = rom.FullPathNorm + suffix + ".srm";
+    }
+
+    void OpenRemoteLibrary(const std::string &urlPath) {
+        std::ifstream file(urlPath);
+        std::string manifestUrl;
+        if (!(file >> manifestUrl))
+            return;
+
+        if (!RemoteLibrary::IsRemote(manifestUrl)) {
+            OVR_LOG("remote library: only http is supported: %s", manifestUrl.c_str());
+            return;
+        }
+
+        OVR_LOG("remote library: %s", manifestUrl.c_str());
+        remoteLibrary.Open(manifestUrl, stateFolderPath + libraryManifestFileName);
+        remoteLibraryOpen = true;
+    }
+
+    void ReadNetplayConfig(const std::string &configPath) {
+        std::ifstream file(configPath);
+        if (!(file >> netplayLocalPort >> netplayRemoteHost >> netplayRemotePort))
+            return;
+
+        OVR_LOG("netplay: port %i, peer %s:%i", netplayLocalPort, netplayRemoteHost.c_str(), netplayRemotePort);
+        netplayConfigured = true;
+    }
+
+    bool memoryMarked;
+
+    // everything loaded for the first game is the baseline, growth after switching games is reported as a possible leak
+    void LogMemoryReport() {
+        if (!memoryMarked) {
+            memoryMarked = true;
+            MemoryTracker::Mark();
+            return;
+        }
+
+        std::string report = MemoryTracker::Report(true);
+        size_t start = 0, end;
+        while ((end = report.find('\n', start)) != std::string::npos) {
+            OVR_LOG("memory %s", report.substr(start, end - start).c_str());
+            start = end + 1;
+        }
+    }
+
+    std::string RomKey(const Rom &rom) {
+        return rom.FullPath + ":" + rom.ArchiveEntry;
+    }
+
+    // runs on the preload thread, everything LoadGame would read from the disk
+    bool PreloadRom(const Rom &listRom, Preloader::Data &data) {
+        Rom rom = listRom;
+        rom.PatchPath = FindPatch(listRom);
+        data.patchPath = rom.PatchPath;
+
+        if (!ReadRomData(rom, data.rom))
+            return false;
+        if (!rom.PatchPath.empty())
+            SetPatchedIdentity(rom, (uint32_t) crc32(0, data.rom.data(), (uInt) data.rom.size()));
+
+        std::ifstream ramFile(rom.SavePath, std::ios::in | std::ios::binary | std::ios::ate);
+        data.hasRam = ramFile.is_open();
+        if (data.hasRam) {
+            data.ram.resize((size_t) ramFile.tellg());
+            ramFile.seekg(0, std::ios::beg);
+            data.hasRam = (bool) ramFile.read((char *) data.ram.data(), data.ram.size());
+        }
+
+        const size_t imageSize = VIDEO_WIDTH * VIDEO_HEIGHT;
+        data.slotImages.resize(Preloader::SLOT_COUNT * imageSize);
+        data.slotImageMask = data.slotStateMask = 0;
+        for (int i = 0; i < Preloader::SLOT_COUNT; ++i) {
+            std::ifstream imageFile(SlotPath(rom.RomName, ".stateimg", i), std::ios::in | std::ios::binary);
+            if (imageFile.read((char *) &data.slotImages[i * imageSize], imageSize))
+                data.slotImageMask |= 1u << i;
+
+            struct stat info;
+            if (stat(SlotPath(rom.RomName, ".state", i).c_str(), &info) == 0)
+                data.slotStateMask |= 1u << i;
+        }
+        return true;
+    }
+
+    void UsePreloadedRam(const Preloader::Data &data) {
+        if (!data.hasRam) {
+            OVR_LOG("could not load ram file: %s", ctx->CurrentRom->SavePath.c_str());
+            return;
+        }
+        if (data.ram.size() != VRVB::save_ram_size()) {
+            OVR_LOG("ERROR loaded ram size is wrong");
+            return;
+        }
+        memcpy(VRVB::save_ram(), data.ram.data(), data.ram.size());
+    }
+
+    void UsePreloadedSlots(const Preloader::Data &data) {
+        const size_t imageSize = VIDEO_WIDTH * VIDEO_HEIGHT;
+        for (int i = 0; i < Preloader::SLOT_COUNT; ++i) {
+            ctx->currentGame->saveStates[i].hasImage = (data.slotImageMask & (1u << i)) != 0;
+            if (ctx->currentGame->saveStates[i].hasImage)
+                memcpy(ctx->currentGame->saveStates[i].saveImage, &data.slotImages[i * imageSize], imageSize);
+            else
+                memset(ctx->currentGame->saveStates[i].saveImage, 0, imageSize);
+            ctx->currentGame->saveStates[i].hasState = (data.slotStateMask & (1u << i)) != 0;
+        }
+    }
+
+    void LogLaunch(bool preloaded, double seconds) {
+        if (preloaded) {
+            preloadHits++;
+            preloadHitLaunchTime += seconds;
+        } else {
+            preloadMisses++;
+            preloadMissLaunchTime += seconds;
+        }
+
+        Preloader::Stats stats = preloader.GetStats();
+        OVR_LOG("launch %s in %.1fms, preloaded %u of %u launches (avg %.1fms, without %.1fms), %u preloads, %u discarded, %u over budget, "
+                "%u not ready", preloaded ? "preloaded" : "cold", seconds * 1000, preloadHits, preloadHits + preloadMisses,
+                preloadHits ? preloadHitLaunchTime * 1000 / preloadHits : 0.0,
+                preloadMisses ? preloadMissLaunchTime * 1000 / preloadMisses : 0.0, stats.loads, stats.discarded, stats.overBudget,
+                stats.notReady);
+    }
+
     void LoadGame(Rom *rom) {
+        WaitForSlots();
+
         // save the ram of the old rom
         SaveRam();
+        StopRecording();
 
         OVR_LOG("LOAD VRVB ROM %s", rom->FullPath.c_str());
-        std::ifstream file(rom->FullPath, std::ios::in | std::ios::binary | std::ios::ate);
-        if (file.is_open()) {
-            long romBufferSize = file.tellg();
-            char *memblock = new char[romBufferSize];
+        double ioStartTime = SystemClock::GetTimeInSeconds();
+        BufferPool::Buffer romData = ioBuffers.Acquire(romBufferCapacity);
+
+        Rom *loadRom = rom;
+        std::string patchPath = FindPatch(*rom);
+        if (!patchPath.empty()) {
+            patchedRom = *rom;
+            patchedRom.PatchPath = patchPath;
+            loadRom = &patchedRom;
+        }
 
-            file.seekg(0, std::ios::beg);
-            file.read(memblock, romBufferSize);
-            file.close();
+        Preloader::Data prepared;
+        bool preloaded = preloader.Take(RomKey(*rom), prepared) && prepared.patchPath == patchPath;
+
+        bool loaded = preloaded;
+        if (preloaded) {
+            romData->swap(prepared.rom);
+        } else {
+            loaded = ReadRomData(*loadRom, *romData);
+            if (!loaded && loadRom != rom) {
+                OVR_LOG("loading the rom without the patch");
+                loadRom = rom;
+                loaded = ReadRomData(*rom, *romData);
+            }
+        }
 
-            VRVB::LoadRom((const uint8_t *) memblock, (size_t) romBufferSize);
+        if (loaded) {
+            if (!preloaded)
+                RecordIo(FlightRecorder::IoLoadRom, romData->size(), ioStartTime);
 
-            delete[] memblock;
+            VRVB::LoadRom(romData->data(), romData->size());
+            ctx->currentRomHash = (uint32_t) crc32(0, romData->data(), (uInt) romData->size());
+            ctx->emulatedFrame = 0;
+            ramFromNetplayHost = false;
+            replayableRun = true;
 
-            CurrentRom = rom;
-            OVR_LOG("finished loading rom %ld", romBufferSize);
+            if (loadRom == &patchedRom)
+                SetPatchedIdentity(patchedRom, ctx->currentRomHash);
+            ctx->CurrentRom = loadRom;
+            OVR_LOG("finished loading rom %i", (int) romData->size());
 
             OVR_LOG("start loading ram");
-            LoadRam();
+            if (preloaded)
+                UsePreloadedRam(prepared);
+            else
+                LoadRam();
             OVR_LOG("finished loading ram");
+
+            LoadCheats();
         } else {
             OVR_LOG("could not load VB rom file");
         }
 
+        if (preloaded)
+            UsePreloadedSlots(prepared);
+        else
+            LoadSlots();
+        UpdateStateImage(0);
+        ValidateSlots();
+
+        LogLaunch(preloaded, SystemClock::GetTimeInSeconds() - ioStartTime);
+        LogMemoryReport();
+        OVR_LOG("LOADED VRVB ROM");
+    }
+
+    // starts preloading once the selection stayed on a rom for a moment
+    void UpdatePreload() {
+        if (romList == nullptr)
+            return;
+
+        int selection = romList->CurrentSelection;
+        double time = SystemClock::GetTimeInSeconds();
+        if (selection != preloadSelection) {
+            preloadSelection = selection;
+            preloadSelectionTime = time;
+            return;
+        }
+        if (time - preloadSelectionTime < preloadDwellTime || selection < 0 || selection >= (int) ctx->romFileList.size())
+            return;
+
+        const Rom &rom = ctx->romFileList[selection];
+        // the running game does not need to get loaded again
+        if (ctx->CurrentRom != nullptr && RomKey(*ctx->CurrentRom) == RomKey(rom))
+            return;
+
+        preloader.Request(RomKey(rom), [rom](Preloader::Data &data) { return PreloadRom(rom, data); });
+    }
+
+    void LoadSlots() {
         for (int i = 0; i < 10; ++i) {
             if (!LoadStateImage(i)) {
-                currentGame->saveStates[i].hasImage = false;
+                ctx->currentGame->saveStates[i].hasImage = false;
 
                 // clear memory
-                memset(currentGame->saveStates[i].saveImage, 0,
-                       sizeof(uint8_t) * VIDEO_WIDTH * 2 * VIDEO_HEIGHT);
+                memset(ctx->currentGame->saveStates[i].saveImage, 0,
+                       sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
             } else {
-                currentGame->saveStates[i].hasImage = true;
+                ctx->currentGame->saveStates[i].hasImage = true;
             }
 
-            currentGame->saveStates[i].hasState = StateExists(i);
+            ctx->currentGame->saveStates[i].hasState = StateExists(i);
         }
-
-        UpdateStateImage(0);
-
-        OVR_LOG("LOADED VRVB ROM");
     }
 
-    void Init(std::string appFolderPath) {
-        stateFolderPath = appFolderPath + stateFilePath;
+    void Suspend() {
+        // the java thread and the gl thread can both suspend, only one of them gets to write the snapshot
+        if (snapshotWriting.exchange(true))
+            return;
 
-        // set the button mapping
-        UpdateButtonMapping();
+        ResumeSnapshot::Snapshot *snapshot = new ResumeSnapshot::Snapshot();
+        {
+            // the gl thread changes the current rom and moves the rom list under the same lock
+            std::lock_guard<std::mutex> lock(coreMutex);
+            if (ctx->CurrentRom == nullptr) {
+                delete snapshot;
+                snapshotWriting = false;
+                return;
+            }
+            snapshot->RomName = ctx->CurrentRom->RomName;
+            snapshot->FullPath = ctx->CurrentRom->FullPath;
+            snapshot->FullPathNorm = ctx->CurrentRom->FullPathNorm;
+            snapshot->SavePath = ctx->CurrentRom->SavePath;
+            snapshot->ArchiveEntry = ctx->CurrentRom->ArchiveEntry;
+            snapshot->PatchPath = ctx->CurrentRom->PatchPath;
+
+            SaveRam();
+            // the app might not come back so the capture gets finished now
+            StopRecording();
+
+            snapshot->State.resize(VRVB::retro_serialize_size());
+            VRVB::retro_serialize(snapshot->State.data(), snapshot->State.size());
+            if (ctx->currentScreenData)
+                snapshot->Frame.assign((const uint8_t *) ctx->currentScreenData, (const uint8_t *) ctx->currentScreenData + CORE_FRAME_SIZE);
+        }
 
-        OVR_LOG("VRVB INIT w %i, %i, %i, %i", CylinderWidth, CylinderHeight, VIDEO_WIDTH, VIDEO_HEIGHT);
-        // emu screen layer
-        // left layer
-        int cubeSizeX = CylinderWidth;
-        int cubeSizeY = CylinderWidth;
+        // reading the rom and compressing everything is done in the background
+        std::string path = stateFolderPath + resumeFileName;
+        std::thread([snapshot, path]() {
+            FlightRecorder::InstallThread();
+            double ioStartTime = SystemClock::GetTimeInSeconds();
+            Rom rom;
+            rom.FullPath = snapshot->FullPath;
+            rom.ArchiveEntry = snapshot->ArchiveEntry;
+            rom.PatchPath = snapshot->PatchPath;
+            if (ReadRomData(rom, snapshot->Rom)) {
+                if (ResumeSnapshot::Write(path, *snapshot)) {
+                    RecordIo(FlightRecorder::IoSnapshot, snapshot->Rom.size() + snapshot->State.size(), ioStartTime);
+                    OVR_LOG("wrote resume snapshot %s", path.c_str());
+                } else {
+                    OVR_LOG("could not write resume snapshot %s", path.c_str());
+                }
+            }
 
-        screenPosY = CylinderWidth / 2 - CylinderHeight / 2;
-        OVR_LOG("screePosY %i", screenPosY);
+            delete snapshot;
+            snapshotWriting = false;
+        }).detach();
+    }
 
-        for (int y = 0; y < cubeSizeY; ++y) {
-            for (int x = 0; x < cubeSizeX; ++x) {
-                pixelData[x + y * cubeSizeX] = 0xFFFF00FF;
-            }
+    bool Resume() {
+        std::string path = stateFolderPath + resumeFileName;
+        ResumeSnapshot::Snapshot snapshot;
+        bool valid = ResumeSnapshot::Read(path, snapshot);
+        // a snapshot only gets used once, a new one gets written the next time the app gets suspended
+        remove(path.c_str());
+        if (!valid) {
+            OVR_LOG("no valid resume snapshot found");
+            return false;
         }
-        GLfloat borderColor[] = {1.0f, 0.0f, 0.0f, 1.0f};
-
-        glGenTextures(1, &screenTextureId);
-        glBindTexture(GL_TEXTURE_2D, screenTextureId);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, VIDEO_WIDTH, VIDEO_HEIGHT * 2 + screenborder * 4, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-        glBindTexture(GL_TEXTURE_2D, 0);
 
         {
-            int borderSize = screenborder;
-            // left texture
-            CylinderSwapChain =
-                    vrapi_CreateTextureSwapChain(VRAPI_TEXTURE_TYPE_2D, VRAPI_TEXTURE_FORMAT_8888_sRGB, CylinderWidth * 2 + borderSize * 2,
-                                                 TextureHeight * 2 + borderSize * 2, 1, false);
-            screenTextureCylinderId = vrapi_GetTextureSwapChainHandle(CylinderSwapChain, 0);
-            glBindTexture(GL_TEXTURE_2D, screenTextureCylinderId);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CylinderWidth * 2 + borderSize * 2, TextureHeight * 2 + borderSize * 2, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            //glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            std::lock_guard<std::mutex> lock(coreMutex);
+            VRVB::LoadRom(snapshot.Rom.data(), snapshot.Rom.size());
+            ctx->currentRomHash = (uint32_t) crc32(0, snapshot.Rom.data(), (uInt) snapshot.Rom.size());
+            ctx->emulatedFrame = 0;
+            replayableRun = false;
+            // the state also contains the save ram so it does not need to get loaded
+            VRVB::retro_unserialize(snapshot.State.data(), snapshot.State.size());
+
+            resumeRom.RomName = snapshot.RomName;
+            resumeRom.FullPath = snapshot.FullPath;
+            resumeRom.FullPathNorm = snapshot.FullPathNorm;
+            resumeRom.SavePath = snapshot.SavePath;
+            resumeRom.ArchiveEntry = snapshot.ArchiveEntry;
+            resumeRom.PatchPath = snapshot.PatchPath;
+            ctx->CurrentRom = &resumeRom;
+        }
+        LoadCheats();
 
-            // create the framebuffer for the screen texture
-            glGenFramebuffers(1, &screenFramebuffer[0]);
-            glBindFramebuffer(GL_FRAMEBUFFER, screenFramebuffer[0]);
-            // Set "renderedTexture" as our colour attachement #0
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTextureCylinderId, 0);
-            // Set the list of draw buffers.
-            GLenum DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-            glDrawBuffers(1, DrawBuffers);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // show the last frame until the core produces a new one
+        if (snapshot.Frame.size() == CORE_FRAME_SIZE) {
+            resumeFrame.swap(snapshot.Frame);
+            ctx->currentScreenData = resumeFrame.data();
+            UpdateScreen(ctx->currentScreenData);
         }
 
-        OVR_LOG("INIT VRVB");
-        VRVB::Init();
+        resumeMenuClose = true;
 
-        VRVB::audio_cb = VB_Audio_CB;
-        VRVB::video_cb = VB_VIDEO_CB;
+        // the save slots are not needed for the first frame
+        ValidateSlots();
+        slotThread = std::thread([]() {
+            FlightRecorder::InstallThread();
+            LoadSlots();
+            slotsLoaded = true;
+        });
 
-        InitStateImage();
-        currentGame = new LoadedGame();
-        for (int i = 0; i < 10; ++i) {
-            currentGame->saveStates[i].saveImage = new uint8_t[VIDEO_WIDTH * 2 * VIDEO_HEIGHT]();
+        LogStartup("resumed");
+        return true;
+    }
+
+    // quad in the same space as BuildTesselatedQuad; the curved version bends it around the viewer with the screen
+    // distance as radius so every column keeps the same distance to the eyes
+    GlGeometry BuildScreenMesh(bool curved, int columns) {
+        const Vector3f size = SceneScreenBounds.b[1] - SceneScreenBounds.b[0];
+        const Vector3f center = SceneScreenBounds.b[0] + size * 0.5f;
+        const float halfWidth = size.x * 0.5f;
+        const float radius = -center.z;
+
+        if (!curved)
+            columns = 1;
+
+        VertexAttribs attribs;
+        attribs.position.Resize((columns + 1) * 2);
+        attribs.uv0.Resize((columns + 1) * 2);
+
+        for (int y = 0; y <= 1; ++y) {
+            for (int x = 0; x <= columns; ++x) {
+                const float u = x / (float) columns;
+                float posX = u * 2.0f - 1.0f;
+                float posZ = 0.0f;
+
+                if (curved) {
+                    const float angle = posX * halfWidth / radius;
+                    posX = radius * sinf(angle) / halfWidth;
+                    posZ = radius * (1.0f - cosf(angle));
+                }
+
+                const int index = y * (columns + 1) + x;
+                attribs.position[index] = Vector3f(posX, y * 2.0f - 1.0f, posZ);
+                attribs.uv0[index] = Vector2f(u, 1.0f - y);
+            }
         }
 
+        Array<TriangleIndex> indices;
+        indices.Resize(columns * 6);
+        for (int x = 0; x < columns; ++x) {
+            indices[x * 6 + 0] = (TriangleIndex) x;
+            indices[x * 6 + 1] = (TriangleIndex) (x + 1);
+            indices[x * 6 + 2] = (TriangleIndex) (columns + 1 + x);
+            indices[x * 6 + 3] = (TriangleIndex) (columns + 1 + x);
+            indices[x * 6 + 4] = (TriangleIndex) (x + 1);
+            indices[x * 6 + 5] = (TriangleIndex) (columns + 2 + x);
+        }
+
+        return GlGeometry(attribs, indices);
+    }
+
+    // the eye buffer program is only needed for the eye buffer screens so it gets build the first time it is used
+    void InitScreenSurface() {
+        screenSurfaceInit = true;
+
         static ovrProgramParm MovieExternalUiUniformParms[] =
                 {
                         {"TextureMatrices", ovrProgramParmType::BUFFER_UNIFORM},
@@ -581,7 +1497,6 @@ namespace Emulator {
 
         // this leads to the app crashing on exit
         // ScreenSurfaceDef.surfaceName = "ScreenSurf";
-        ScreenSurfaceDef.geo = BuildTesselatedQuad(1, 1);
         ScreenSurfaceDef.graphicsCommand.Program = MovieExternalUiProgram;
         ScreenSurfaceDef.graphicsCommand.UniformData[0].Data = &ScreenTexMatrices;
         ScreenSurfaceDef.graphicsCommand.UniformData[1].Data = &ScreenColor[0];
@@ -589,22 +1504,104 @@ namespace Emulator {
         ScreenSurfaceDef.graphicsCommand.UniformData[3].Data = &ScreenTexture[1];
         ScreenSurfaceDef.graphicsCommand.UniformData[4].Data = &ScreenColor[1];
 
+        OVR_LOG("built screen surface program");
+    }
+
+    void Init(std::string appFolderPath) {
+        LogStartup("init");
+        stateFolderPath = appFolderPath + stateFilePath;
+
+        FlightRecorder::Install(stateFolderPath + "flightrecorder.dump");
+        romCache.Init(stateFolderPath + romCacheFolder, romCacheSize);
+        OpenRemoteLibrary(appFolderPath + romFolderPath + libraryUrlFileName);
+        ReadNetplayConfig(appFolderPath + romFolderPath + netplayConfigFileName);
+
+        // set the button mapping
+        UpdateButtonMapping();
+
+        OVR_LOG("VRVB INIT w %i, %i, %i, %i", CylinderWidth, CylinderHeight, VIDEO_WIDTH, VIDEO_HEIGHT);
+        // emu screen layer
+        // left layer
+
+        screenPosY = CylinderWidth / 2 - CylinderHeight / 2;
+        OVR_LOG("screePosY %i", screenPosY);
+
+        ctx->pixelData = new int32_t[VIDEO_WIDTH * TextureHeight];
+        for (int i = 0; i < VIDEO_WIDTH * TextureHeight; ++i)
+            ctx->pixelData[i] = 0xFFFF00FF;
+        MemoryTracker::Allocated(MemoryTracker::TagVideo, sizeof(int32_t) * VIDEO_WIDTH * TextureHeight);
+        MemoryTracker::Allocated(MemoryTracker::TagMenu, sizeof(int32_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
+
+        PerformanceGovernor::Reset(governorState, governorConfig);
+        RunState::Reset(runState, SystemClock::GetTimeInSeconds());
+        frameCostStatsStart = SystemClock::GetTimeInSeconds();
+
+        // the core and the state buffers do not need the gl context
+        std::thread coreThread([]() {
+            FlightRecorder::InstallThread();
+            OVR_LOG("INIT VRVB");
+            VRVB::Init();
+            LogStartup("core init");
+
+            // the slot images only hold the left eye
+            ctx->currentGame = new LoadedGame();
+            for (int i = 0; i < 10; ++i) {
+                ctx->currentGame->saveStates[i].saveImage = new uint8_t[VIDEO_WIDTH * VIDEO_HEIGHT]();
+            }
+            MemoryTracker::Allocated(MemoryTracker::TagStates, sizeof(LoadedGame) + 10 * VIDEO_WIDTH * VIDEO_HEIGHT);
+        });
+
+        CreateScreenTextures();
+        InitStateImage();
+        InitScreenShapeIcon();
+        coverCache.Init();
+        LogStartup("screen textures");
+
+        coreThread.join();
+
+        ctx->audioCallback = VB_Audio_CB;
+        ctx->videoCallback = VB_VIDEO_CB;
+        SetActiveContext(ctx);
+
         Vector3f size(5.25f, 5.25f * (VIDEO_HEIGHT / (float) VIDEO_WIDTH), 0.0f);
 
         SceneScreenBounds = Bounds3f(size * -0.5f, size * 0.5f);
         SceneScreenBounds.Translate(Vector3f(0.0f, 1.66f, -5.61f));
+        ScreenModelMatrix = ScreenMatrix();
 
         startTime = SystemClock::GetTimeInSeconds();
+        LogStartup("init finished");
+
+        Resume();
     }
 
     void UpdateEmptySlotLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
-        item->Visible = !currentGame->saveStates[saveSlot].hasState;
+        WaitForSlots();
+        item->Visible = !ctx->currentGame->saveStates[saveSlot].hasState;
     }
 
     void UpdateNoImageSlotLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        WaitForSlots();
         item->Visible =
-                currentGame->saveStates[saveSlot].hasState &&
-                !currentGame->saveStates[saveSlot].hasImage;
+                ctx->currentGame->saveStates[saveSlot].hasState &&
+                !ctx->currentGame->saveStates[saveSlot].hasImage &&
+                !ctx->currentGame->saveStates[saveSlot].stateBroken;
+    }
+
+    void UpdateBrokenSlotLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        WaitForSlots();
+        item->Visible =
+                ctx->currentGame->saveStates[saveSlot].hasState &&
+                ctx->currentGame->saveStates[saveSlot].stateBroken;
+    }
+
+    void UpdateSpeedLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        item->Visible = fastForwardMode != 0;
+        ((MenuLabel *) item)->Text = "Speed while playing: " + to_string((int) (achievedSpeed * 10) / 10.0f) + "x";
+    }
+
+    void UpdateMemoryLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        ((MenuLabel *) item)->Text = MemoryTracker::Summary();
     }
 
     void InitMainMenu(int posX, int posY, Menu &mainMenu) {
@@ -620,14 +1617,35 @@ namespace Emulator {
                               VIDEO_WIDTH, VIDEO_HEIGHT, {1.0f, 1.0f, 1.0f, 1.0f});
         emptySlotLabel->UpdateFunction = UpdateEmptySlotLabel;
 
+        MenuLabel *speedLabel =
+                new MenuLabel(&fontSlot, "", MENU_WIDTH - VIDEO_WIDTH - 20,
+                              HEADER_HEIGHT + offsetY + VIDEO_HEIGHT + 10,
+                              VIDEO_WIDTH, 30, {1.0f, 1.0f, 1.0f, 1.0f});
+        speedLabel->UpdateFunction = UpdateSpeedLabel;
+
+        MenuLabel *memoryLabel =
+                new MenuLabel(&fontSlot, "", MENU_WIDTH - VIDEO_WIDTH - 20,
+                              HEADER_HEIGHT + offsetY + VIDEO_HEIGHT + 40,
+                              VIDEO_WIDTH, 30, {1.0f, 1.0f, 1.0f, 1.0f});
+        memoryLabel->UpdateFunction = UpdateMemoryLabel;
+
         MenuLabel *noImageSlotLabel =
                 new MenuLabel(&fontSlot, "- -", MENU_WIDTH - VIDEO_WIDTH - 20,
                               HEADER_HEIGHT + offsetY,
                               VIDEO_WIDTH, VIDEO_HEIGHT, {1.0f, 1.0f, 1.0f, 1.0f});
         noImageSlotLabel->UpdateFunction = UpdateNoImageSlotLabel;
 
+        MenuLabel *brokenSlotLabel =
+                new MenuLabel(&fontSlot, "- Broken Slot -", MENU_WIDTH - VIDEO_WIDTH - 20,
+                              HEADER_HEIGHT + offsetY,
+                              VIDEO_WIDTH, VIDEO_HEIGHT, {1.0f, 1.0f, 1.0f, 1.0f});
+        brokenSlotLabel->UpdateFunction = UpdateBrokenSlotLabel;
+
         mainMenu.MenuItems.push_back(emptySlotLabel);
         mainMenu.MenuItems.push_back(noImageSlotLabel);
+        mainMenu.MenuItems.push_back(brokenSlotLabel);
+        mainMenu.MenuItems.push_back(speedLabel);
+        mainMenu.MenuItems.push_back(memoryLabel);
         // image slot
         mainMenu.MenuItems.push_back(new MenuImage(stateImageId, MENU_WIDTH - VIDEO_WIDTH - 20,
                                                    HEADER_HEIGHT + offsetY, VIDEO_WIDTH,
@@ -635,70 +1653,266 @@ namespace Emulator {
                                                    {1.0f, 1.0f, 1.0f, 1.0f}));
     }
 
-    void ChangeColor(MenuButton *item, int colorIndex, float dir) {
-        color[colorIndex] += dir;
+    // the palette buttons change all three colors at once, the screen only needs to get converted once for all of them
+    void RefreshScreen() {
+        frameScheduler.Post("screen", FrameScheduler::PriorityHigh, []() {
+            if (ctx->currentScreenData)
+                UpdateScreen(ctx->currentScreenData);
+            return true;
+        });
+    }
+
+    void ChangeColor(MenuButton *item, int colorIndex, float dir) {
+        ctx->color[colorIndex] += dir;
+
+        if (ctx->color[colorIndex] < 0)
+            ctx->color[colorIndex] = 0;
+        else if (ctx->color[colorIndex] > 1)
+            ctx->color[colorIndex] = 1;
+
+        item->Text = strColor[colorIndex] + to_string(ctx->color[colorIndex]);
+
+        // update screen
+        RefreshScreen();
+        // update save slot color
+        UpdateStateImage(saveSlot);
+    }
+
+    void ChangeOffset(MenuButton *item, float dir) {
+        threedeeIPD += dir;
+
+        if (threedeeIPD < minIPD)
+            threedeeIPD = minIPD;
+        else if (threedeeIPD > maxIPD)
+            threedeeIPD = maxIPD;
+
+        item->Text = "IPD offset: " + to_string(threedeeIPD * 256);
+    }
+
+    void ChangePalette(MenuButton *item, float dir) {
+        selectedPredefColor += dir;
+        if (selectedPredefColor < 0)
+            selectedPredefColor = predefColorCount - 1;
+        else if (selectedPredefColor >= predefColorCount)
+            selectedPredefColor = 0;
+
+        ctx->color[0] = predefColors[selectedPredefColor].x;
+        ctx->color[1] = predefColors[selectedPredefColor].y;
+        ctx->color[2] = predefColors[selectedPredefColor].z;
+
+        ChangeColor(rButton, 0, 0);
+        ChangeColor(gButton, 1, 0);
+        ChangeColor(bButton, 2, 0);
+
+        item->Text = "Palette: " + to_string(selectedPredefColor);
+
+        // update screen
+        RefreshScreen();
+        // update save slot color
+        UpdateStateImage(saveSlot);
+    }
+
+    void SetThreeDeeMode(MenuItem *item, bool newMode) {
+        useThreeDeeMode = newMode;
+        ((MenuButton *) item)->IconId = useThreeDeeMode ? threedeeIconId : twodeeIconId;
+        ((MenuButton *) item)->Text = useThreeDeeMode ? "3D Screen" : "2D Screen";
+
+        UpdateScreenMode();
+        if (ctx->currentScreenData)
+            UpdateScreen(ctx->currentScreenData);
+    }
+
+    void ChangeScreenShape(MenuButton *item, int dir) {
+        screenShape = (screenShape + dir + SCREEN_SHAPE_COUNT) % SCREEN_SHAPE_COUNT;
+        item->Text = screenShapeNames[screenShape];
+    }
+
+    void ChangeScreenMeshDetail(MenuButton *item, int dir) {
+        screenMeshDetail = (screenMeshDetail + dir + SCREEN_MESH_DETAIL_COUNT) % SCREEN_MESH_DETAIL_COUNT;
+        item->Text = "Curve Detail: " + std::string(screenMeshDetailNames[screenMeshDetail]);
+    }
+
+    void ChangeFastForward(MenuButton *item, int dir) {
+        fastForwardMode += dir;
+        if (fastForwardMode < 0)
+            fastForwardMode = FAST_FORWARD_MODE_COUNT - 1;
+        else if (fastForwardMode >= FAST_FORWARD_MODE_COUNT)
+            fastForwardMode = 0;
+
+        audioCredit = 0;
+        item->Text = "Fast Forward: " + strFastForward[fastForwardMode];
+    }
+
+    void OnClickFastForwardLeft(MenuItem *item) { ChangeFastForward((MenuButton *) item, -1); }
+
+    void OnClickFastForwardRight(MenuItem *item) { ChangeFastForward((MenuButton *) item, 1); }
+
+    std::string CheatPath() {
+        return stateFolderPath + ctx->CurrentRom->RomName + ".cht";
+    }
+
+    void UpdateSearchButton() {
+        if (!searchButton)
+            return;
+
+        searchButton->Text = std::string("RAM Search: ") + MemorySearch::CompareName(searchCompare);
+        if (memorySearch.memory)
+            searchButton->Text += " (" + to_string(memorySearch.candidateCount) + ")";
+    }
+
+    void UpdateCheatButton() {
+        if (cheatButton)
+            cheatButton->Text = "Cheats: " + to_string(cheatList.cheats.size()) + (cheatList.enabled ? " On" : " Off");
+    }
+
+    void LoadCheats() {
+        memorySearch = MemorySearch::Search();
+        if (Cheats::Load(CheatPath(), cheatList))
+            OVR_LOG("loaded %i cheats", (int) cheatList.cheats.size());
+
+        UpdateSearchButton();
+        UpdateCheatButton();
+    }
+
+    void OnClickSearch(MenuItem *item) {
+        // the sram is the only memory the core exposes
+        uint8_t *memory = (uint8_t *) VRVB::save_ram();
+        size_t size = VRVB::save_ram_size();
+        if (ctx->CurrentRom == nullptr || memory == nullptr || size == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(coreMutex);
+        double searchStartTime = SystemClock::GetTimeInSeconds();
+        // a search without candidates left starts over
+        if (!memorySearch.memory || memorySearch.candidateCount == 0)
+            MemorySearch::Start(memorySearch, memory, size);
+        else
+            MemorySearch::Refine(memorySearch, searchCompare);
+
+        OVR_LOG("ram search %s: %i candidates in %.3fms", MemorySearch::CompareName(searchCompare),
+                (int) memorySearch.candidateCount, (SystemClock::GetTimeInSeconds() - searchStartTime) * 1000);
+        UpdateSearchButton();
+    }
+
+    void ChangeSearchCompare(int dir) {
+        // values can not be entered in the menu so CompareValue is left out
+        int compareCount = MemorySearch::CompareValue;
+        searchCompare = (MemorySearch::Compare) ((searchCompare + dir + compareCount) % compareCount);
+        UpdateSearchButton();
+    }
+
+    void OnClickSearchLeft(MenuItem *item) { ChangeSearchCompare(-1); }
 
-        if (color[colorIndex] < 0)
-            color[colorIndex] = 0;
-        else if (color[colorIndex] > 1)
-            color[colorIndex] = 1;
+    void OnClickSearchRight(MenuItem *item) { ChangeSearchCompare(1); }
 
-        item->Text = strColor[colorIndex] + to_string(color[colorIndex]);
+    // freezes the remaining candidates of the search at their current values
+    void OnClickAddCheats(MenuItem *item) {
+        if (ctx->CurrentRom == nullptr || memorySearch.candidateCount == 0 || memorySearch.candidateCount > MAX_CHEAT_CANDIDATES)
+            return;
 
-        // update screen
-        if (currentScreenData)
-            UpdateScreen(currentScreenData);
-        // update save slot color
-        UpdateStateImage(saveSlot);
+        std::vector<uint32_t> addresses;
+        MemorySearch::Candidates(memorySearch, addresses, MAX_CHEAT_CANDIDATES);
+        for (uint32_t address : addresses)
+            Cheats::Set(cheatList, address, memorySearch.snapshot[address]);
+
+        if (!Cheats::Save(CheatPath(), cheatList))
+            OVR_LOG("could not save cheat file");
+
+        memorySearch = MemorySearch::Search();
+        UpdateSearchButton();
+        UpdateCheatButton();
     }
 
-    void ChangeOffset(MenuButton *item, float dir) {
-        threedeeIPD += dir;
+    void OnClickToggleCheats(MenuItem *item) {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        cheatList.enabled = !cheatList.enabled;
+        if (!cheatList.enabled)
+            Cheats::Restore(cheatList, (uint8_t *) VRVB::save_ram(), VRVB::save_ram_size());
+        UpdateCheatButton();
+    }
 
-        if (threedeeIPD < minIPD)
-            threedeeIPD = minIPD;
-        else if (threedeeIPD > maxIPD)
-            threedeeIPD = maxIPD;
+    std::string CapturePath(const std::string &extension) {
+        return stateFolderPath + ctx->CurrentRom->RomName + "_" + to_string((long long) time(nullptr)) + extension;
+    }
 
-        item->Text = "IPD offset: " + to_string(threedeeIPD * 256);
+    void OnClickScreenshot(MenuItem *item) {
+        if (ctx->CurrentRom == nullptr || ctx->currentScreenData == nullptr)
+            return;
+
+        std::string path = CapturePath(".pgm");
+        Capture::SaveScreenshot(path, (const uint8_t *) ctx->currentScreenData);
+        OVR_LOG("saved screenshot %s", path.c_str());
     }
 
-    void ChangePalette(MenuButton *item, float dir) {
-        selectedPredefColor += dir;
-        if (selectedPredefColor < 0)
-            selectedPredefColor = predefColorCount - 1;
-        else if (selectedPredefColor >= predefColorCount)
-            selectedPredefColor = 0;
+    void StopRecording() {
+        if (!recorder.IsRecording())
+            return;
 
-        color[0] = predefColors[selectedPredefColor].x;
-        color[1] = predefColors[selectedPredefColor].y;
-        color[2] = predefColors[selectedPredefColor].z;
+        recorder.Stop();
+        Capture::Stats stats = recorder.GetStats();
+        OVR_LOG("capture finished: %u frames, %u dropped, %llu bytes", stats.framesWritten, stats.framesDropped,
+                (unsigned long long) stats.bytesWritten);
+    }
 
-        ChangeColor(rButton, 0, 0);
-        ChangeColor(gButton, 1, 0);
-        ChangeColor(bButton, 2, 0);
+    void UpdateRecordButton(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        if (!recorder.IsRecording()) {
+            ((MenuButton *) item)->Text = "Record: Off";
+            return;
+        }
 
-        item->Text = "Palette: " + to_string(selectedPredefColor);
+        Capture::Stats stats = recorder.GetStats();
+        ((MenuButton *) item)->Text = "Record: " + to_string(stats.framesWritten) + " (" + to_string(stats.framesDropped) + " dropped)";
+    }
 
-        // update screen
-        if (currentScreenData)
-            UpdateScreen(currentScreenData);
-        // update save slot color
-        UpdateStateImage(saveSlot);
+    void UpdateFrameExportButton(MenuButton *item) {
+        item->Text = std::string("Frame Export: ") + (framePublisher.IsOpen() ? "On" : "Off");
     }
 
-    void SetThreeDeeMode(MenuItem *item, bool newMode) {
-        useThreeDeeMode = newMode;
-        ((MenuButton *) item)->IconId = useThreeDeeMode ? threedeeIconId : twodeeIconId;
-        ((MenuButton *) item)->Text = useThreeDeeMode ? "3D Screen" : "2D Screen";
+    void UpdateMemoryOverlayButton(MenuButton *item) {
+        item->Text = std::string("Memory Overlay: ") + (memoryOverlay ? "On" : "Off");
     }
 
-    void SetCurvedMove(MenuItem *item, bool newMode) {
-        useCubeMap = newMode;
-        ((MenuButton *) item)->Text = useCubeMap ? "Flat Screen" : "Curved Screen";
+    void OnClickMemoryOverlay(MenuItem *item) {
+        memoryOverlay = !memoryOverlay;
+        UpdateMemoryOverlayButton((MenuButton *) item);
+    }
+
+    void OnClickFrameExport(MenuItem *item) {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        if (framePublisher.IsOpen()) {
+            framePublisher.Close();
+        } else {
+            if (framePublisher.Open(FrameExport::SOCKET_NAME))
+                OVR_LOG("exporting frames, readers connect to @%s", FrameExport::SOCKET_NAME);
+            else
+                OVR_LOG("could not start the frame export on @%s", FrameExport::SOCKET_NAME);
+        }
+        UpdateFrameExportButton((MenuButton *) item);
+    }
+
+    void OnClickRecord(MenuItem *item) {
+        if (recorder.IsRecording()) {
+            StopRecording();
+            return;
+        }
+
+        if (ctx->CurrentRom == nullptr)
+            return;
+
+        std::string path = CapturePath(".vbcap");
+        if (recorder.Start(path, (uint32_t) (emulationSpeed * 1000)))
+            OVR_LOG("started capture %s", path.c_str());
+        else
+            OVR_LOG("could not start capture %s", path.c_str());
     }
 
-    void OnClickCurveScreen(MenuItem *item) { SetCurvedMove(item, !useCubeMap); }
+    void OnClickScreenShapeLeft(MenuItem *item) { ChangeScreenShape((MenuButton *) item, -1); }
+
+    void OnClickScreenShapeRight(MenuItem *item) { ChangeScreenShape((MenuButton *) item, 1); }
+
+    void OnClickScreenMeshDetailLeft(MenuItem *item) { ChangeScreenMeshDetail((MenuButton *) item, -1); }
+
+    void OnClickScreenMeshDetailRight(MenuItem *item) { ChangeScreenMeshDetail((MenuButton *) item, 1); }
 
     void OnClickScreenMode(MenuItem *item) { SetThreeDeeMode(item, !useThreeDeeMode); }
 
@@ -727,14 +1941,56 @@ namespace Emulator {
         ChangeOffset((MenuButton *) item, 0);
     }
 
-    void InitSettingsMenu(int &posX, int &posY, Menu &settingsMenu) {
-        //MenuButton *curveButton =
-        //    new MenuButton(&fontMenu, texturePaletteIconId, "", posX, posY += menuItemSize,
-        //                   OnClickCurveScreen, nullptr, nullptr);
+    void LeaveNetplay() {
+        if (netplaySession == nullptr)
+            return;
+
+        StopNetplay();
+        netplayTransport.reset();
+        OVR_LOG("stopped netplay");
+    }
+
+    void OnClickNetplay(MenuItem *item) {
+        if (netplaySession != nullptr) {
+            LeaveNetplay();
+            return;
+        }
+        if (!netplayConfigured || ctx->CurrentRom == nullptr)
+            return;
+
+        netplayTransport.reset(new Netplay::UdpTransport(netplayLocalPort, netplayRemoteHost.c_str(), netplayRemotePort));
+        if (!netplayTransport->IsOpen()) {
+            OVR_LOG("netplay: could not open port %i for %s", netplayLocalPort, netplayRemoteHost.c_str());
+            netplayTransport.reset();
+            return;
+        }
+        StartNetplay(netplayTransport.get());
+    }
+
+    void UpdateNetplayButton(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        if (!netplayConfigured)
+            ((MenuButton *) item)->Text = "Netplay: no " + netplayConfigFileName;
+        else if (netplaySession == nullptr)
+            ((MenuButton *) item)->Text = "Netplay: Off";
+        else if (netplaySession->State() == Netplay::SyncMismatch)
+            ((MenuButton *) item)->Text = "Netplay: different game";
+        else if (netplaySession->State() != Netplay::SyncRunning)
+            ((MenuButton *) item)->Text = "Netplay: connecting to " + netplayRemoteHost;
+        else
+            ((MenuButton *) item)->Text = "Netplay: " + netplayRemoteHost + " (" + to_string(netplaySession->stats.stalls) + " stalls)";
+    }
 
+    void InitSettingsMenu(int &posX, int &posY, Menu &settingsMenu) {
         MenuButton *screenModeButton =
                 new MenuButton(&fontMenu, threedeeIconId, "", posX, posY += menuItemSize, OnClickScreenMode, OnClickScreenMode, OnClickScreenMode);
 
+        MenuButton *screenShapeButton =
+                new MenuButton(&fontMenu, screenShapeIconId, "", posX, posY += menuItemSize, OnClickScreenShapeRight,
+                               OnClickScreenShapeLeft, OnClickScreenShapeRight);
+        MenuButton *screenMeshDetailButton =
+                new MenuButton(&fontMenu, screenShapeIconId, "", posX, posY += menuItemSize, OnClickScreenMeshDetailRight,
+                               OnClickScreenMeshDetailLeft, OnClickScreenMeshDetailRight);
+
         MenuButton *offsetButton =
                 new MenuButton(&fontMenu, textureIpdIconId, "", posX, posY += menuItemSize, OnClickResetOffset, OnClickOffsetLeft,
                                OnClickOffsetRight);
@@ -746,28 +2002,101 @@ namespace Emulator {
         gButton = new MenuButton(&fontMenu, texturePaletteIconId, "", posX, posY += menuItemSize, nullptr, OnClickGLeft, OnClickGRight);
         bButton = new MenuButton(&fontMenu, texturePaletteIconId, "", posX, posY += menuItemSize, nullptr, OnClickBLeft, OnClickBRight);
 
-        //settingsMenu.MenuItems.push_back(curveButton);
+        MenuButton *fastForwardButton =
+                new MenuButton(&fontMenu, mappingRightRightId, "", posX, posY += menuItemSize + 5, OnClickFastForwardRight,
+                               OnClickFastForwardLeft, OnClickFastForwardRight);
+
+        // like the color buttons the buttons of a group share the icon of the first one
+        searchButton = new MenuButton(&fontMenu, textureVbIconId, "", posX, posY += menuItemSize + 5, OnClickSearch,
+                                      OnClickSearchLeft, OnClickSearchRight);
+        cheatButton = new MenuButton(&fontMenu, textureVbIconId, "", posX, posY += menuItemSize, OnClickAddCheats,
+                                     OnClickToggleCheats, OnClickToggleCheats);
+
+        MenuButton *screenshotButton =
+                new MenuButton(&fontMenu, twodeeIconId, "Screenshot", posX, posY += menuItemSize + 5, OnClickScreenshot, nullptr, nullptr);
+        recordButton = new MenuButton(&fontMenu, twodeeIconId, "", posX, posY += menuItemSize, OnClickRecord, nullptr, nullptr);
+        recordButton->UpdateFunction = UpdateRecordButton;
+        MenuButton *frameExportButton =
+                new MenuButton(&fontMenu, twodeeIconId, "", posX, posY += menuItemSize, OnClickFrameExport, OnClickFrameExport,
+                               OnClickFrameExport);
+        MenuButton *memoryOverlayButton =
+                new MenuButton(&fontMenu, twodeeIconId, "", posX, posY += menuItemSize, OnClickMemoryOverlay, OnClickMemoryOverlay,
+                               OnClickMemoryOverlay);
+
+        MenuButton *netplayButton =
+                new MenuButton(&fontMenu, mappingStartId, "", posX, posY += menuItemSize + 5, OnClickNetplay, nullptr, nullptr);
+        netplayButton->UpdateFunction = UpdateNetplayButton;
+
         settingsMenu.MenuItems.push_back(screenModeButton);
+        settingsMenu.MenuItems.push_back(screenShapeButton);
+        settingsMenu.MenuItems.push_back(screenMeshDetailButton);
         settingsMenu.MenuItems.push_back(offsetButton);
         settingsMenu.MenuItems.push_back(paletteButton);
         settingsMenu.MenuItems.push_back(rButton);
         settingsMenu.MenuItems.push_back(gButton);
         settingsMenu.MenuItems.push_back(bButton);
+        settingsMenu.MenuItems.push_back(fastForwardButton);
+        settingsMenu.MenuItems.push_back(searchButton);
+        settingsMenu.MenuItems.push_back(cheatButton);
+        settingsMenu.MenuItems.push_back(screenshotButton);
+        settingsMenu.MenuItems.push_back(recordButton);
+        settingsMenu.MenuItems.push_back(frameExportButton);
+        settingsMenu.MenuItems.push_back(memoryOverlayButton);
+        settingsMenu.MenuItems.push_back(netplayButton);
 
         ChangeOffset(offsetButton, 0);
         SetThreeDeeMode(screenModeButton, useThreeDeeMode);
+        ChangeScreenShape(screenShapeButton, 0);
+        ChangeScreenMeshDetail(screenMeshDetailButton, 0);
         ChangePalette(paletteButton, 0);
+        ChangeFastForward(fastForwardButton, 0);
+        UpdateSearchButton();
+        UpdateCheatButton();
+        UpdateFrameExportButton(frameExportButton);
+        UpdateMemoryOverlayButton(memoryOverlayButton);
+    }
+
+    // roms that are not in the cache yet get downloaded by the worker of the library instead of blocking the gl thread
+    bool QueueRemoteLaunch(const Rom &rom) {
+        RemoteLibrary::Entry entry;
+        if (!RemoteLibrary::IsRemote(rom.FullPath) || !remoteLibrary.Find(rom.FullPath, entry))
+            return false;
+
+        uint32_t downloadedBytes;
+        if (remoteLibrary.GetStatus(entry, downloadedBytes) == RemoteLibrary::Library::StatusCached)
+            return false;
+
+        OVR_LOG("waiting for the download of %s", rom.FullPath.c_str());
+        remoteLibrary.Prefetch(entry);
+        launchEntry = entry;
+        launchPending = true;
+        launchDownloadedBytes = 0;
+        return true;
     }
 
     void OnClickRom(Rom *rom) {
         OVR_LOG("LOAD ROM");
+        launchPending = false;
+        if (QueueRemoteLaunch(*rom))
+            return;
+
+        // the other player still runs the old game
+        LeaveNetplay();
+        std::lock_guard<std::mutex> lock(coreMutex);
         LoadGame(rom);
         ResetMenuState();
     }
 
+    void UpdateDownloadLabel(MenuItem *item, uint *buttonState, uint *lastButtonState) {
+        item->Visible = launchPending;
+        if (launchPending)
+            ((MenuLabel *) item)->Text = "Downloading " + launchEntry.Name + ": " +
+                                         to_string((int) (launchDownloadedBytes * 100.0 / std::max(launchEntry.size, 1u))) + "%";
+    }
+
     void InitRomSelectionMenu(int posX, int posY, Menu &romSelectionMenu) {
         // rom list
-        romList = new MenuList<Rom>(&fontList, OnClickRom, romFileList, 10, HEADER_HEIGHT + 10,
+        romList = new MenuList<Rom>(&fontList, OnClickRom, &ctx->romFileList, 10, HEADER_HEIGHT + 10,
                                     MENU_WIDTH - 20, (MENU_HEIGHT - HEADER_HEIGHT - BOTTOM_HEIGHT - 20));
 
         if (romSelection < 0 || romSelection >= romList->ItemList->size())
@@ -775,16 +2104,24 @@ namespace Emulator {
 
         romList->CurrentSelection = romSelection;
         romSelectionMenu.MenuItems.push_back(romList);
+
+        MenuLabel *downloadLabel = new MenuLabel(&fontSlot, "", 10, MENU_HEIGHT - BOTTOM_HEIGHT - 40, MENU_WIDTH - 20, 30,
+                                                 {1.0f, 1.0f, 1.0f, 1.0f});
+        downloadLabel->UpdateFunction = UpdateDownloadLabel;
+        romSelectionMenu.MenuItems.push_back(downloadLabel);
     }
 
     void SaveEmulatorSettings(std::ofstream *saveFile) {
         saveFile->write(reinterpret_cast<const char *>(&romList->CurrentSelection), sizeof(int));
-        saveFile->write(reinterpret_cast<const char *>(&color[0]), sizeof(float));
-        saveFile->write(reinterpret_cast<const char *>(&color[1]), sizeof(float));
-        saveFile->write(reinterpret_cast<const char *>(&color[2]), sizeof(float));
+        saveFile->write(reinterpret_cast<const char *>(&ctx->color[0]), sizeof(float));
+        saveFile->write(reinterpret_cast<const char *>(&ctx->color[1]), sizeof(float));
+        saveFile->write(reinterpret_cast<const char *>(&ctx->color[2]), sizeof(float));
         saveFile->write(reinterpret_cast<const char *>(&selectedPredefColor), sizeof(int));
         saveFile->write(reinterpret_cast<const char *>(&threedeeIPD), sizeof(float));
         saveFile->write(reinterpret_cast<const char *>(&useThreeDeeMode), sizeof(bool));
+        saveFile->write(reinterpret_cast<const char *>(&fastForwardMode), sizeof(int));
+        saveFile->write(reinterpret_cast<const char *>(&screenShape), sizeof(int));
+        saveFile->write(reinterpret_cast<const char *>(&screenMeshDetail), sizeof(int));
 
         // save button mapping
         for (int i = 0; i < buttonCount; ++i) {
@@ -801,12 +2138,21 @@ namespace Emulator {
     void LoadEmulatorSettings(std::ifstream *readFile) {
 
         readFile->read((char *) &romSelection, sizeof(int));
-        readFile->read((char *) &color[0], sizeof(float));
-        readFile->read((char *) &color[1], sizeof(float));
-        readFile->read((char *) &color[2], sizeof(float));
+        readFile->read((char *) &ctx->color[0], sizeof(float));
+        readFile->read((char *) &ctx->color[1], sizeof(float));
+        readFile->read((char *) &ctx->color[2], sizeof(float));
         readFile->read((char *) &selectedPredefColor, sizeof(int));
         readFile->read((char *) &threedeeIPD, sizeof(float));
         readFile->read((char *) &useThreeDeeMode, sizeof(bool));
+        readFile->read((char *) &fastForwardMode, sizeof(int));
+        if (fastForwardMode < 0 || fastForwardMode >= FAST_FORWARD_MODE_COUNT)
+            fastForwardMode = 0;
+        readFile->read((char *) &screenShape, sizeof(int));
+        if (screenShape < 0 || screenShape >= SCREEN_SHAPE_COUNT)
+            screenShape = ScreenCylinderLayer;
+        readFile->read((char *) &screenMeshDetail, sizeof(int));
+        if (screenMeshDetail < 0 || screenMeshDetail >= SCREEN_MESH_DETAIL_COUNT)
+            screenMeshDetail = 2;
 
         // load button mapping
         for (int i = 0; i < buttonCount; ++i) {
@@ -826,19 +2172,87 @@ namespace Emulator {
         }
     }
 
+    bool IsRomFile(const std::string &name) {
+        size_t lastIndex = name.find_last_of(".");
+        if (lastIndex == std::string::npos)
+            return false;
+
+        std::string extension = name.substr(lastIndex);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension != ".zip" &&
+               std::find(supportedFileNames.begin(), supportedFileNames.end(), extension) != supportedFileNames.end();
+    }
+
+    // "FullPath:ArchiveEntry" of every rom in the list
+    std::unordered_set<std::string> romFileKeys;
+
+    // scanning the folder again does not add the roms a second time
+    bool AddRomEntry(const Rom &newRom) {
+        if (!romFileKeys.insert(newRom.FullPath + ":" + newRom.ArchiveEntry).second)
+            return false;
+
+        ctx->romFileList.push_back(newRom);
+        MemoryTracker::Allocated(MemoryTracker::TagLibrary, sizeof(Rom) + newRom.RomName.size() + newRom.FullPath.size() +
+                                                            newRom.FullPathNorm.size() + newRom.SavePath.size() +
+                                                            newRom.ArchiveEntry.size());
+        return true;
+    }
+
+    // only the index of the archive gets read, every rom inside of it becomes its own entry
+    void AddArchive(const std::string &strFullPath, const std::string &listName, const std::string &listNameSave) {
+        std::vector<RomArchive::Entry> entries;
+        if (!RomArchive::ReadIndex(strFullPath, entries)) {
+            OVR_LOG("could not read archive: %s", strFullPath.c_str());
+            return;
+        }
+
+        std::vector<const RomArchive::Entry *> romEntries;
+        for (const RomArchive::Entry &entry : entries)
+            if (IsRomFile(entry.Name))
+                romEntries.push_back(&entry);
+
+        for (const RomArchive::Entry *entry : romEntries) {
+            // archives with more than one rom get the name of the rom appended
+            std::string suffix;
+            if (romEntries.size() > 1) {
+                std::string entryName = entry->Name.substr(entry->Name.find_last_of('/') + 1);
+                suffix = " - " + entryName.substr(0, entryName.find_last_of("."));
+            }
+
+            Rom newRom;
+            newRom.RomName = listName + suffix;
+            newRom.FullPath = strFullPath;
+            newRom.FullPathNorm = listNameSave + suffix;
+            newRom.SavePath = listNameSave + suffix + ".srm";
+            newRom.ArchiveEntry = entry->Name;
+
+            if (!AddRomEntry(newRom))
+                continue;
+
+            OVR_LOG("found rom: %s %s:%s %s", newRom.RomName.c_str(), newRom.FullPath.c_str(),
+                    newRom.ArchiveEntry.c_str(), newRom.SavePath.c_str());
+        }
+    }
+
     void AddRom(std::string strFullPath, std::string strFilename) {
         size_t lastIndex = strFilename.find_last_of(".");
         std::string listName = strFilename.substr(0, lastIndex);
         size_t lastIndexSave = (strFullPath).find_last_of(".");
         std::string listNameSave = strFullPath.substr(0, lastIndexSave);
 
+        if (RomArchive::IsArchive(strFullPath)) {
+            AddArchive(strFullPath, listName, listNameSave);
+            return;
+        }
+
         Rom newRom;
         newRom.RomName = listName;
         newRom.FullPath = strFullPath;
         newRom.FullPathNorm = listNameSave;
         newRom.SavePath = listNameSave + ".srm";
 
-        romFileList->push_back(newRom);
+        if (!AddRomEntry(newRom))
+            return;
 
         OVR_LOG("found rom: %s %s %s", newRom.RomName.c_str(), newRom.FullPath.c_str(),
                 newRom.SavePath.c_str());
@@ -851,98 +2265,254 @@ namespace Emulator {
 
     void SortRomList() {
         OVR_LOG("sort list");
-        std::sort(romFileList->begin(), romFileList->end(), SortByRomName);
+        std::sort(ctx->romFileList.begin(), ctx->romFileList.end(), SortByRomName);
         OVR_LOG("finished sorting list");
     }
 
+    // the list gets sorted again so the current rom and the selection need to be found again afterwards
+    void MergeRemoteEntries() {
+        std::vector<RemoteLibrary::Entry> entries;
+        if (!remoteLibrary.TakeEntries(entries))
+            return;
+
+        Rom currentRom, selectedRom;
+        if (ctx->CurrentRom != nullptr && ctx->CurrentRom != &resumeRom && ctx->CurrentRom != &patchedRom)
+            currentRom = *ctx->CurrentRom;
+        bool hasSelection = romList->CurrentSelection >= 0 && romList->CurrentSelection < (int) ctx->romFileList.size();
+        if (hasSelection)
+            selectedRom = ctx->romFileList[romList->CurrentSelection];
+
+        // adding roms can move the list the current rom points into, suspending reads it from the java thread
+        std::lock_guard<std::mutex> lock(coreMutex);
+        int addedRoms = 0;
+        for (const RemoteLibrary::Entry &entry : entries) {
+            Rom newRom;
+            newRom.RomName = entry.Name;
+            newRom.FullPath = entry.Url;
+            // saves of remote roms are stored next to the states
+            newRom.FullPathNorm = stateFolderPath + entry.Name;
+            newRom.SavePath = newRom.FullPathNorm + ".srm";
+
+            if (AddRomEntry(newRom))
+                addedRoms++;
+        }
+
+        if (addedRoms == 0)
+            return;
+
+        SortRomList();
+        OVR_LOG("remote library: added %i roms", addedRoms);
+
+        for (size_t i = 0; i < ctx->romFileList.size(); ++i) {
+            const Rom &rom = ctx->romFileList[i];
+            if (!currentRom.FullPath.empty() && rom.FullPath == currentRom.FullPath && rom.ArchiveEntry == currentRom.ArchiveEntry)
+                ctx->CurrentRom = &ctx->romFileList[i];
+            if (hasSelection && rom.FullPath == selectedRom.FullPath && rom.ArchiveEntry == selectedRom.ArchiveEntry)
+                romList->CurrentSelection = (int) i;
+        }
+        prefetchSelection = -1;
+    }
+
+    // the hovered remote rom gets downloaded in the background so loading it does not have to wait
+    void PrefetchSelectedRom() {
+        int selection = romList->CurrentSelection;
+        if (selection == prefetchSelection || selection < 0 || selection >= (int) ctx->romFileList.size())
+            return;
+        prefetchSelection = selection;
+
+        const Rom &rom = ctx->romFileList[selection];
+        RemoteLibrary::Entry entry;
+        if (RemoteLibrary::IsRemote(rom.FullPath) && remoteLibrary.Find(rom.FullPath, entry))
+            remoteLibrary.Prefetch(entry);
+    }
+
+    // starts the queued remote rom once the worker put it into the cache
+    void UpdateRemoteLaunch() {
+        RemoteLibrary::Library::Status status = remoteLibrary.GetStatus(launchEntry, launchDownloadedBytes);
+        if (status == RemoteLibrary::Library::StatusDownloading)
+            return;
+
+        launchPending = false;
+        if (status != RemoteLibrary::Library::StatusCached) {
+            OVR_LOG("could not download %s", launchEntry.Url.c_str());
+            return;
+        }
+
+        for (Rom &rom : ctx->romFileList) {
+            if (rom.FullPath == launchEntry.Url) {
+                OnClickRom(&rom);
+                return;
+            }
+        }
+    }
+
+    void UpdateRemoteLibrary() {
+        if (!remoteLibraryOpen || romList == nullptr)
+            return;
+
+        MergeRemoteEntries();
+        // the selection must not replace the download of the rom that is about to get started
+        if (launchPending)
+            UpdateRemoteLaunch();
+        else
+            PrefetchSelectedRom();
+    }
+
+    GLuint GetRomCover(const Rom &rom, bool visible) {
+        std::string coverPath = rom.FullPathNorm + coverFileExtension;
+        std::string fallbackPath = stateFolderPath + rom.RomName + ".stateimg";
+
+        if (!visible) {
+            coverCache.Prefetch(rom.FullPathNorm, coverPath, fallbackPath);
+            return 0;
+        }
+        return coverCache.Get(rom.FullPathNorm, coverPath, fallbackPath);
+    }
+
+    void UpdateCovers() {
+        coverCache.Update();
+
+        double time = SystemClock::GetTimeInSeconds();
+        if (time - lastCoverStatsTime < 60)
+            return;
+        lastCoverStatsTime = time;
+
+        CoverCache::Stats stats = coverCache.GetStats();
+        if (stats.lookups == 0)
+            return;
+        OVR_LOG("covers: %.1f%% of %u rows in view had their cover, %u decodes (%u without cover), %u evictions, decode %.2fms avg %.2fms max",
+                stats.hits * 100.0f / stats.lookups, stats.lookups, stats.decodes, stats.missing, stats.evictions,
+                stats.decodes > 0 ? stats.decodeSeconds * 1000 / stats.decodes : 0.0, stats.maxDecodeSeconds * 1000);
+    }
+
     void ResetGame() {
+        std::lock_guard<std::mutex> lock(coreMutex);
         VRVB::Reset();
+        ctx->emulatedFrame = 0;
+        replayableRun = true;
     }
 
     void SaveRam() {
-        if (CurrentRom != nullptr && VRVB::save_ram_size() > 0) {
+        if (ramFromNetplayHost) {
+            OVR_LOG("not saving the save ram of the netplay host");
+            return;
+        }
+        if (ctx->CurrentRom != nullptr && VRVB::save_ram_size() > 0) {
             OVR_LOG("save ram %i", (int) VRVB::save_ram_size());
-            std::ofstream outfile(CurrentRom->SavePath, std::ios::trunc | std::ios::binary);
-            outfile.write((const char *) VRVB::save_ram(), VRVB::save_ram_size());
+            double ioStartTime = SystemClock::GetTimeInSeconds();
+            const uint8_t *ram = (const uint8_t *) VRVB::save_ram();
+            // the cheats only change the running game and not the save file
+            std::vector<uint8_t> ramWithoutCheats;
+            if (Cheats::CopyWithoutCheats(cheatList, ram, VRVB::save_ram_size(), ramWithoutCheats))
+                ram = ramWithoutCheats.data();
+            std::ofstream outfile(ctx->CurrentRom->SavePath, std::ios::trunc | std::ios::binary);
+            outfile.write((const char *) ram, VRVB::save_ram_size());
             outfile.close();
+            RecordIo(FlightRecorder::IoSaveRam, VRVB::save_ram_size(), ioStartTime);
             OVR_LOG("finished writing ram file");
         }
     }
 
     void LoadRam() {
-        std::ifstream file(CurrentRom->SavePath, std::ios::in | std::ios::binary | std::ios::ate);
+        double ioStartTime = SystemClock::GetTimeInSeconds();
+        std::ifstream file(ctx->CurrentRom->SavePath, std::ios::in | std::ios::binary | std::ios::ate);
         if (file.is_open()) {
             long romBufferSize = file.tellg();
-            char *memblock = new char[romBufferSize];
-            file.seekg(0, std::ios::beg);
-            file.read(memblock, romBufferSize);
-            file.close();
-            OVR_LOG("loaded ram %ld", romBufferSize);
-
             OVR_LOG("ram size %i", (int) VRVB::save_ram_size());
 
+            // the file gets read straight into the sram of the core
             if (romBufferSize != (int) VRVB::save_ram_size()) {
                 OVR_LOG("ERROR loaded ram size is wrong");
             } else {
-                memcpy(VRVB::save_ram(), memblock, VRVB::save_ram_size());
-                OVR_LOG("finished loading ram");
+                file.seekg(0, std::ios::beg);
+                file.read((char *) VRVB::save_ram(), romBufferSize);
+                RecordIo(FlightRecorder::IoLoadRam, (size_t) romBufferSize, ioStartTime);
+                OVR_LOG("finished loading ram %ld", romBufferSize);
             }
-
-            delete[] memblock;
+            file.close();
         } else {
-            OVR_LOG("could not load ram file: %s", CurrentRom->SavePath.c_str());
+            OVR_LOG("could not load ram file: %s", ctx->CurrentRom->SavePath.c_str());
         }
     }
 
+    void LogBufferStats() {
+        BufferPool::Stats stats = ioBuffers.GetStats();
+        OVR_LOG("io buffers: %u allocations (%llu bytes) for %u uses", stats.allocations, (unsigned long long) stats.bytesAllocated,
+                stats.acquires);
+    }
+
     void SaveState(int slot) {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        WaitForSlots();
+        // only one state gets written at a time, saving twice in a row must not end with the older one on disk
+        WaitForStateWrite();
+
         // get the size of the savestate
         size_t size = VRVB::retro_serialize_size();
 
         if (size > 0) {
-            std::string savePath = stateFolderPath + CurrentRom->RomName + ".state";
-            if (saveSlot > 0) savePath += to_string(saveSlot);
+            std::string savePath = SlotPath(ctx->CurrentRom->RomName, ".state", saveSlot);
 
             OVR_LOG("save slot");
-            void *data = new uint8_t[size];
-            VRVB::retro_serialize(data, size);
-
-            OVR_LOG("save slot to %s", savePath.c_str());
-            std::ofstream outfile(savePath, std::ios::trunc | std::ios::binary);
-            outfile.write((const char *) data, size);
-            outfile.close();
-            OVR_LOG("finished writing slot to file");
+            BufferPool::Buffer data = ioBuffers.Acquire(size);
+            data->resize(size);
+            VRVB::retro_serialize(data->data(), size);
+
+            // writing and the two syncs take long enough to drop frames, the gl thread only serializes
+            StateFile::Identity identity = StateIdentity();
+            stateWriteThread = std::thread([savePath, identity, size, data = std::move(data)]() mutable {
+                FlightRecorder::InstallThread();
+                OVR_LOG("save slot to %s", savePath.c_str());
+                double ioStartTime = SystemClock::GetTimeInSeconds();
+                if (StateFile::Write(savePath, identity, data->data(), size))
+                    OVR_LOG("finished writing slot to file");
+                else
+                    OVR_LOG("could not write slot to file");
+                RecordIo(FlightRecorder::IoSaveState, size, ioStartTime);
+            });
+            LogBufferStats();
         }
 
         OVR_LOG("copy image");
-        memcpy(currentGame->saveStates[saveSlot].saveImage, screenData,
+        memcpy(ctx->currentGame->saveStates[saveSlot].saveImage, ctx->screenData,
                sizeof(uint8_t) * VIDEO_WIDTH * VIDEO_HEIGHT);
         OVR_LOG("update image");
         UpdateStateImage(saveSlot);
         // save image for the slot
         SaveStateImage(saveSlot);
-        currentGame->saveStates[saveSlot].hasImage = true;
-        currentGame->saveStates[saveSlot].hasState = true;
+        // the first slot doubles as the cover of roms without one
+        if (saveSlot == 0)
+            coverCache.Invalidate(ctx->CurrentRom->FullPathNorm);
+        ctx->currentGame->saveStates[saveSlot].hasImage = true;
+        ctx->currentGame->saveStates[saveSlot].hasState = true;
+        ctx->currentGame->saveStates[saveSlot].stateBroken = false;
+        slotSavedDuringValidation[saveSlot] = true;
     }
 
     void LoadState(int slot) {
-        std::string savePath = stateFolderPath + CurrentRom->RomName + ".state";
-        if (slot > 0) savePath += to_string(slot);
-
-        std::ifstream file(savePath, std::ios::in | std::ios::binary | std::ios::ate);
-        if (file.is_open()) {
-            long size = file.tellg();
-            char *data = new char[size];
-
-            file.seekg(0, std::ios::beg);
-            file.read(data, size);
-            file.close();
-            OVR_LOG("loaded slot has size: %ld", size);
-
-            VRVB::retro_unserialize(data, size);
-
-            delete[] data;
+        std::lock_guard<std::mutex> lock(coreMutex);
+        WaitForSlots();
+        WaitForStateWrite();
+
+        std::string savePath = SlotPath(ctx->CurrentRom->RomName, ".state", slot);
+
+        double ioStartTime = SystemClock::GetTimeInSeconds();
+        StateFile::Identity identity = StateIdentity();
+        BufferPool::Buffer data = ioBuffers.Acquire(identity.stateSize);
+        StateFile::Status status = StateFile::Read(savePath, identity, *data);
+        if (StateFile::IsUsable(status)) {
+            RecordIo(FlightRecorder::IoLoadState, data->size(), ioStartTime);
+            OVR_LOG("loaded %s slot has size: %i", StateFile::Name(status), (int) data->size());
+
+            VRVB::retro_unserialize(data->data(), data->size());
+            replayableRun = false;
+            LogBufferStats();
+        } else if (status == StateFile::StatusMissing) {
+            OVR_LOG("could not load state file: %s", savePath.c_str());
         } else {
-            OVR_LOG("could not load ram file: %s", CurrentRom->SavePath.c_str());
+            // a broken state would leave the core in an undefined state
+            OVR_LOG("not loading %s state file: %s", StateFile::Name(status), savePath.c_str());
+            ctx->currentGame->saveStates[slot].stateBroken = true;
         }
     }
 
@@ -1022,13 +2592,280 @@ namespace Emulator {
         }
     }
 
+    void MeasureSpeed(int frames) {
+        measuredFrames += frames;
+
+        double currentTime = SystemClock::GetTimeInSeconds();
+        if (currentTime - speedMeasureStart >= 1) {
+            achievedSpeed = (float) (measuredFrames / ((currentTime - speedMeasureStart) * emulationSpeed));
+            measuredFrames = 0;
+            speedMeasureStart = currentTime;
+        }
+    }
+
+    // called when playing stops, the rest of the window still counts for the value shown in the menu
+    void FinishSpeedMeasure(double time) {
+        if (time - speedMeasureStart >= minSpeedMeasureTime)
+            achievedSpeed = (float) (measuredFrames / ((time - speedMeasureStart) * emulationSpeed));
+        measuredFrames = 0;
+    }
+
+    void ApplyClockLevels() {
+        ovrMobile *ovr = appInterface->app->GetOvrMobile();
+        if (ovr == nullptr)
+            return;
+
+        if (runState.state == RunState::Playing)
+            vrapi_SetClockLevels(ovr, governorState.cpuLevel, governorState.gpuLevel);
+        else
+            vrapi_SetClockLevels(ovr, governorConfig.minLevel, governorConfig.minLevel);
+    }
+
+    void ApplyGovernorState() {
+        ApplyClockLevels();
+
+        skipUpscale = governorState.degradeLevel >= PerformanceGovernor::DegradeSkipUpscale;
+        forceMono = governorState.degradeLevel >= PerformanceGovernor::DegradeMono;
+        frameskip = governorState.degradeLevel >= PerformanceGovernor::DegradeFrameskip;
+
+        OVR_LOG("governor: cpu %i, gpu %i, degrade %s, temp %.1f", governorState.cpuLevel, governorState.gpuLevel,
+                PerformanceGovernor::DegradeName(governorState.degradeLevel).c_str(), governorState.temperature);
+
+        // the screen textures or the swap chain that gets shown could have changed
+        UpdateScreenMode();
+        if (ctx->currentScreenData)
+            UpdateScreen(ctx->currentScreenData);
+    }
+
+    void UpdateGovernor(const ovrFrameInput &vrFrame, double frameCost) {
+        PerformanceGovernor::Sample sample;
+        sample.frameCost = (float) frameCost;
+        sample.deltaSeconds = vrFrame.DeltaSeconds;
+        // only read the sensor once per decision window
+        sample.temperature = governorState.windowFrames == 0 ? PerformanceGovernor::ReadTemperature(thermalZonePath) : 0;
+
+        if (PerformanceGovernor::Update(governorState, governorConfig, sample))
+            ApplyGovernorState();
+    }
+
+    void RunFrames(const ovrFrameInput &vrFrame, uint *buttonState, uint *lastButtonState);
+
+    double lastRunTime;
+
+    void RunCore() {
+        if (!cheatList.cheats.empty())
+            Cheats::Apply(cheatList, (uint8_t *) VRVB::save_ram(), VRVB::save_ram_size());
+
+        double runStartTime = SystemClock::GetTimeInSeconds();
+        VRVB::Run();
+        double runEndTime = SystemClock::GetTimeInSeconds();
+        uint32_t flags = replayableRun && cheatList.cheats.empty() ? FlightRecorder::FrameFromPowerOn : 0;
+        FlightRecorder::RecordFrame(ctx->emulatedFrame, VRVB::input_buf[0], ctx->currentRomHash,
+                                    (uint32_t) ((runEndTime - runStartTime) * 1000000), (uint32_t) ((runEndTime - lastRunTime) * 1000000), flags);
+        lastRunTime = runEndTime;
+
+        ctx->emulatedFrame++;
+        RunState::Current(runState).framesEmulated++;
+    }
+
+    void SetBackground(bool background) {
+        appInBackground = background;
+    }
+
+    void LogRunState() {
+        for (int i = 0; i < RunState::StateCount; ++i) {
+            const RunState::Counters &counters = runState.counters[i];
+            if (counters.seconds <= 0)
+                continue;
+
+            float perMinute = (float) (60 / counters.seconds);
+            OVR_LOG("run state %s: %.1fs, per minute %.0f frames emulated, %.0f uploads (%.1fMB), %.0f audio frames",
+                    RunState::Name((RunState::State) i).c_str(), counters.seconds, counters.framesEmulated * perMinute,
+                    counters.framesUploaded * perMinute, counters.bytesUploaded * perMinute / (1024 * 1024),
+                    counters.audioFrames * perMinute);
+        }
+    }
+
+    void UpdateRunState(RunState::State state) {
+        double time = SystemClock::GetTimeInSeconds();
+        RunState::State previous = runState.state;
+
+        if (RunState::Change(runState, state, time)) {
+            OVR_LOG("run state: %s -> %s", RunState::Name(previous).c_str(), RunState::Name(state).c_str());
+            if (previous == RunState::Playing || state == RunState::Playing)
+                ApplyClockLevels();
+            // the core continues with the frame it stopped at instead of catching up on the paused time
+            if (state == RunState::Playing) {
+                frameCounter = 0;
+                measuredFrames = 0;
+                speedMeasureStart = time;
+            } else if (previous == RunState::Playing) {
+                FinishSpeedMeasure(time);
+            }
+        }
+
+        if (RunState::ReportDue(runState, time, runStateReportWindow)) {
+            LogRunState();
+            RunState::ClearCounters(runState, time);
+        }
+    }
+
+    void UpdateEmulation(const ovrFrameInput &vrFrame, uint *buttonState, uint *lastButtonState);
+
+    void LogFrameCostStats() {
+        const char *names[2] = {"idle", "playing"};
+        for (int i = 0; i < 2; ++i) {
+            FrameCostStats &stats = frameCostStats[i];
+            if (stats.frames == 0)
+                continue;
+
+            double mean = stats.sum / stats.frames;
+            double variance = std::max(0.0, stats.squareSum / stats.frames - mean * mean);
+            OVR_LOG("frame cost %s: %u frames, mean %.2fms, deviation %.2fms, max %.2fms", names[i], stats.frames,
+                    mean * 1000, sqrt(variance) * 1000, stats.max * 1000);
+        }
+
+        OVR_LOG("screen: %s, %u texture matrix uploads", screenShapeNames[screenShape], screenUniformUploads);
+        screenUniformUploads = 0;
+
+        FrameScheduler::Stats stats = frameScheduler.GetStats();
+        OVR_LOG("scheduler: %u posted, %u coalesced, %u chunks, %u forced, max delay %.1fms", stats.posted, stats.coalesced,
+                stats.chunks, stats.forced, stats.maxDelay * 1000);
+
+        memset(frameCostStats, 0, sizeof(frameCostStats));
+        frameScheduler.ClearStats();
+    }
+
+    // runs the deferred menu work in what is left of the frame and measures the cost of the whole frame
+    void RunDeferredWork() {
+        double elapsed = SystemClock::GetTimeInSeconds() - updateStartTime;
+        frameScheduler.Run(schedulerFrameShare / DisplayRefreshRate - elapsed);
+
+        double time = SystemClock::GetTimeInSeconds();
+        double frameCost = time - updateStartTime;
+        FrameCostStats &stats = frameCostStats[runState.state == RunState::Playing ? 1 : 0];
+        stats.frames++;
+        stats.sum += frameCost;
+        stats.squareSum += frameCost * frameCost;
+        stats.max = std::max(stats.max, frameCost);
+
+        if (time - frameCostStatsStart >= 10) {
+            LogFrameCostStats();
+            frameCostStatsStart = time;
+        }
+    }
+
     void Update(const ovrFrameInput &vrFrame, uint *buttonState, uint *lastButtonState) {
+        updateStartTime = SystemClock::GetTimeInSeconds();
+
+        // taking the headset off is treated like the app getting suspended
+        if (headsetMounted && !vrFrame.HeadsetIsMounted)
+            Suspend();
+        headsetMounted = vrFrame.HeadsetIsMounted;
+
+        UpdateRunState(RunState::Decide(appInBackground, headsetMounted, menuOpen));
+        UpdateRemoteLibrary();
+        UpdateCovers();
+        UpdatePreload();
+        UpdateSlotValidation();
+
+        // nothing gets emulated or uploaded while idle, the screen keeps the last frame
+        if (runState.state == RunState::Playing)
+            UpdateEmulation(vrFrame, buttonState, lastButtonState);
+
+        RunDeferredWork();
+    }
+
+    void UpdateEmulation(const ovrFrameInput &vrFrame, uint *buttonState, uint *lastButtonState) {
+        double frameStart = SystemClock::GetTimeInSeconds();
+        {
+            std::lock_guard<std::mutex> lock(coreMutex);
+            RunFrames(vrFrame, buttonState, lastButtonState);
+        }
+        double frameCost = SystemClock::GetTimeInSeconds() - frameStart;
+
+        // fast forward runs several frames or fills the frame budget on purpose, that is no load the governor should react to
+        if (CurrentSpeed() == 1)
+            UpdateGovernor(vrFrame, frameCost);
+    }
+
+    size_t NetplayStateSize() { return VRVB::retro_serialize_size(); }
+
+    bool NetplaySave(void *data, size_t size) { return VRVB::retro_serialize(data, size); }
+
+    bool NetplayLoad(const void *data, size_t size) { return VRVB::retro_unserialize(data, size); }
+
+    void NetplayRun(uint32_t localInput, uint32_t remoteInput, bool present) {
+        // the virtual boy only has a single controller port so both players share it
+        VRVB::input_buf[0] = localInput | remoteInput;
+
+        skipVideoFrame = !present;
+        netplayResimulating = !present;
+        RunCore();
+        skipVideoFrame = false;
+        netplayResimulating = false;
+    }
+
+    void StartNetplay(Netplay::Transport *transport) {
+        StopNetplay();
+
+        Netplay::Core core;
+        core.stateSize = NetplayStateSize;
+        core.save = NetplaySave;
+        core.load = NetplayLoad;
+        core.run = NetplayRun;
+
+        // the rom with its patch and the core have to be the same for both players
+        StateFile::Identity identity = StateIdentity();
+        uint32_t gameHash = (uint32_t) crc32(0, (const Bytef *) &identity, sizeof(identity));
+
+        std::lock_guard<std::mutex> lock(coreMutex);
+        // the game starts over, the session then sends the state of the host with its save ram to the guest
+        VRVB::Reset();
+        ctx->emulatedFrame = 0;
+        // the recorder only sees the local input
+        replayableRun = false;
+        netplaySession = new Netplay::Session(transport, core, gameHash);
+        netplaySyncState = netplaySession->State();
+        OVR_LOG("started netplay, game %08x", gameHash);
+    }
+
+    void StopNetplay() {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        delete netplaySession;
+        netplaySession = nullptr;
+    }
+
+    void RunNetplayFrame(uint32_t input) {
+        netplaySession->RunFrame(input);
+
+        if (netplaySession->State() != netplaySyncState) {
+            netplaySyncState = netplaySession->State();
+            if (netplaySyncState == Netplay::SyncRunning) {
+                OVR_LOG("netplay: synchronized as %s", netplaySession->IsHost() ? "host" : "guest");
+                ramFromNetplayHost |= !netplaySession->IsHost();
+            }
+            else if (netplaySyncState == Netplay::SyncMismatch)
+                OVR_LOG("netplay: the other player runs a different game, patch or core version");
+        }
+
+        if (netplaySession->Frame() % 300 == 0) {
+            Netplay::Stats &stats = netplaySession->stats;
+            OVR_LOG("netplay: rollbacks %u, depth %u (max %u), resimulation %.2fms (max %.2fms), stalls %u",
+                    stats.rollbacks, stats.lastRollbackDepth, stats.maxRollbackDepth,
+                    stats.lastResimulationTime * 1000, stats.maxResimulationTime * 1000, stats.stalls);
+        }
+    }
+
+    void RunFrames(const ovrFrameInput &vrFrame, uint *buttonState, uint *lastButtonState) {
+        int speed = CurrentSpeed();
+        float frameTime = 1 / emulationSpeed / (speed > 0 ? speed : 1);
+
         // methode will only get called "emulationSpeed" times a second
         frameCounter += vrFrame.DeltaSeconds;
-        if (frameCounter < 1 / emulationSpeed) {
+        if (speed > 0 && frameCounter < frameTime) {
             return;
         }
-        frameCounter -= 1 / emulationSpeed;
 
         // TODO
         VRVB::input_buf[0] = 0;
@@ -1040,7 +2877,43 @@ namespace Emulator {
                      (buttonMapping[i].Buttons[1].IsSet &&
                       (buttonState[buttonMapping[i].Buttons[1].InputDevice] & buttonMapping[i].Buttons[1].Button))) ? (1 << i) : 0;
 
-        VRVB::Run();
+        if (speed == 1) {
+            frameCounter -= frameTime;
+            if (netplaySession)
+                RunNetplayFrame(VRVB::input_buf[0]);
+            else
+                RunCore();
+            MeasureSpeed(1);
+            return;
+        }
+
+        // run multiple frames but only convert and upload the last one
+        int frames = 0;
+        skipVideoFrame = true;
+        if (speed > 0) {
+            int framesToRun = (int) (frameCounter / frameTime);
+            // do not try to catch up after a slow frame
+            if (framesToRun > speed * 2)
+                framesToRun = speed * 2;
+            for (; frames < framesToRun; ++frames)
+                RunCore();
+            frameCounter -= frames * frameTime;
+            if (frameCounter > frameTime)
+                frameCounter = 0;
+        } else {
+            double runStartTime = SystemClock::GetTimeInSeconds();
+            do {
+                RunCore();
+                frames++;
+            } while (SystemClock::GetTimeInSeconds() - runStartTime < uncappedFrameBudget);
+            frameCounter = 0;
+        }
+        skipVideoFrame = false;
+
+        if (ctx->currentScreenData)
+            UpdateScreen(ctx->currentScreenData);
+
+        MeasureSpeed(frames);
     }
 
 // Aspect is width / height
@@ -1079,7 +2952,63 @@ namespace Emulator {
                                   (float) VIDEO_HEIGHT); // : ( (float)CurrentMovieWidth / CurrentMovieHeight )
     }
 
+    // the mesh only gets rebuild when the shape or the curve detail changes and the texture matrices only when
+    // the layout of the texture, the 3d mode or the ipd offset change
+    void UpdateScreenSurface() {
+        if (screenMeshShape != screenShape || screenMeshColumns != screenMeshColumnOptions[screenMeshDetail]) {
+            if (screenMeshShape >= 0)
+                ScreenSurfaceDef.geo.Free();
+            screenMeshShape = screenShape;
+            screenMeshColumns = screenMeshColumnOptions[screenMeshDetail];
+            ScreenSurfaceDef.geo = BuildScreenMesh(screenShape == ScreenCurved, screenMeshColumns);
+            OVR_LOG("built screen mesh for %s with %i columns", screenShapeNames[screenShape], screenMeshColumns);
+        }
+
+        // like the cylinder layer both eyes get the left image outside of the 3d mode
+        const bool stereo = !menuOpen && !monoScreen;
+        const float ipd = stereo ? threedeeIPD : 0.0f;
+        if (screenUniformKey.valid && screenUniformKey.mono == monoScreen && screenUniformKey.stereo == stereo &&
+            screenUniformKey.ipd == ipd)
+            return;
+
+        screenUniformKey.valid = true;
+        screenUniformKey.mono = monoScreen;
+        screenUniformKey.stereo = stereo;
+        screenUniformKey.ipd = ipd;
+
+        // the mono textures only hold one image so it needs to get shown completely
+        const float imgHeight = monoScreen ? 1.0f : 0.5f;
+        const float bottomOffset = stereo ? 1.0f - imgHeight : 0.0f;
+        const Matrix4f stretchLeft(
+                1.0f, 0.0f, ipd, 0.0f,
+                0.0f, imgHeight, 0.0f, 0.0f,
+                0.0f, 0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+        const Matrix4f stretchRight(
+                1.0f, 0.0f, -ipd, 0.0f,
+                0.0f, imgHeight, bottomOffset, 0.0f,
+                0.0f, 0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+
+        ScreenTexMatrix[0] = stretchLeft.Transposed();
+        ScreenTexMatrix[1] = stretchRight.Transposed();
+
+        ScreenTexMatrices.Update(2 * sizeof(Matrix4f), &ScreenTexMatrix[0]);
+        screenUniformUploads++;
+    }
+
     void DrawScreenLayer(ovrFrameResult &res, const ovrFrameInput &vrFrame) {
+        if (!firstFramePresented) {
+            firstFramePresented = true;
+            LogStartup("first frame");
+        }
+
+        if (resumeMenuClose) {
+            resumeMenuClose = false;
+            ResetMenuState();
+        }
+        if (slotsLoaded.exchange(false))
+            UpdateStateImage(saveSlot);
 
         /*
              res.Layers[res.LayerCount].Cube = LayerBuilder::BuildCubeLayer(
@@ -1091,38 +3020,27 @@ namespace Emulator {
           res.LayerCount++;
          */
 
-        if (useCubeMap) {
-            Matrix4f texMatrix[2];
-
-            float imgHeight = 0.5f;// (VIDEO_HEIGHT * 2) / (float) (TextureHeight * 2);
-            const Matrix4f stretchTop(
-                    1.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, imgHeight, 0.0f, 0.0f,
-                    0.0f, 0.0f, 1.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f, 1.0f);
-            const Matrix4f stretchBottom(
-                    1.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, imgHeight, 1 - imgHeight, 0.0f,
-                    0.0f, 0.0f, 1.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f, 1.0f);
+        if (screenShape != ScreenCylinderLayer) {
+            if (!screenSurfaceInit)
+                InitScreenSurface();
 
-            texMatrix[0] = texMatrix[1] = Matrix4f::Identity();
-
-            texMatrix[0] = stretchTop;
-            texMatrix[1] = stretchBottom;
-
-            ScreenTexMatrix[0] = texMatrix[0].Transposed();
-            ScreenTexMatrix[1] = texMatrix[1].Transposed();
-
-            ScreenTexMatrices.Update(2 * sizeof(Matrix4f), &ScreenTexMatrix[0]);
+            UpdateScreenSurface();
 
             ScreenSurfaceDef.graphicsCommand.GpuState.depthEnable = false;
-            res.Surfaces.PushBack(ovrDrawSurface(ScreenMatrix(), &ScreenSurfaceDef));
+            res.Surfaces.PushBack(ovrDrawSurface(ScreenModelMatrix, &ScreenSurfaceDef));
         } else {
             // virtual screen layer
             res.Layers[res.LayerCount].Cylinder = LayerBuilder::BuildGameCylinderLayer3D(
-                    CylinderSwapChain, CylinderWidth, CylinderHeight, &vrFrame.Tracking, followHead,
-                    !menuOpen && useThreeDeeMode, threedeeIPD);
+                    skipUpscale ? CylinderSwapChainNative : CylinderSwapChain, CylinderWidth, CylinderHeight, &vrFrame.Tracking, followHead,
+                    !menuOpen && !monoScreen, threedeeIPD);
+            // the mono textures only hold one image so it needs to get shown completely
+            if (monoScreen) {
+                res.Layers[res.LayerCount].Cylinder.Textures[0].TextureMatrix = ovrMatrix4f_CreateIdentity();
+                res.Layers[res.LayerCount].Cylinder.Textures[1].TextureMatrix = ovrMatrix4f_CreateIdentity();
+            } else if (skipUpscale) {
+                res.Layers[res.LayerCount].Cylinder.Textures[0].TextureMatrix = NativeEyeMatrix(0, !menuOpen);
+                res.Layers[res.LayerCount].Cylinder.Textures[1].TextureMatrix = NativeEyeMatrix(1, !menuOpen);
+            }
             res.Layers[res.LayerCount].Cylinder.Header.Flags |=
                     VRAPI_FRAME_LAYER_FLAG_CHROMATIC_ABERRATION_CORRECTION;
             res.Layers[res.LayerCount].Cylinder.Header.Flags |=
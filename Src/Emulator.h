@@ -6,27 +6,15 @@
 #include <VrSamples/FrontendGo/ButtonMapping.h>
 #include "App.h"
 #include "MenuHelper.h"
+#include "EmulatorContext.h"
 
 using namespace OVR;
 
-namespace Emulator {
-
-    struct Rom {
-        std::string RomName;
-        std::string FullPath;
-        std::string FullPathNorm;
-        std::string SavePath;
-    };
-
-    struct SaveState {
-        bool hasImage;
-        bool hasState;
-        uint8_t *saveImage;
-    };
+namespace Netplay {
+    class Transport;
+}
 
-    struct LoadedGame {
-        SaveState saveStates[10];
-    };
+namespace Emulator {
 
     const static int buttonCount = 14;
     extern GLuint *button_icons[];
@@ -60,6 +48,9 @@ namespace Emulator {
 
     void UpdateStateImage(int saveSlot);
 
+    // cover texture for the rom list, 0 while it is loading or if the rom has none
+    GLuint GetRomCover(const Rom &rom, bool visible);
+
     void ChangeButtonMapping(int buttonIndex, int dir);
 
     void UpdateButtonMapping();
@@ -68,6 +59,16 @@ namespace Emulator {
 
     void SaveRam();
 
+    void Suspend();
+
+    // called from the java thread when the activity gets paused or resumed
+    void SetBackground(bool background);
+
+    // the transport has to stay alive until StopNetplay gets called
+    void StartNetplay(Netplay::Transport *transport);
+
+    void StopNetplay();
+
     void Update(const ovrFrameInput &vrFrame, uint* buttonStates, uint* lastButtonStates);
 
     void DrawScreenLayer(ovrFrameResult &res, const ovrFrameInput &vrFrame);
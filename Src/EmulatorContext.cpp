@@ -0,0 +1,30 @@
+#include "EmulatorContext.h"
+
+#include <vrvb.h>
+
+namespace Emulator {
+
+    namespace {
+        Context *activeContext;
+
+        void ContextVideoCallback(const void *data, unsigned width, unsigned height) {
+            if (activeContext && activeContext->videoCallback)
+                activeContext->videoCallback(*activeContext, data, width, height);
+        }
+
+        void ContextAudioCallback(int16_t *samples, int32_t sampleCount) {
+            if (activeContext && activeContext->audioCallback)
+                activeContext->audioCallback(*activeContext, samples, sampleCount);
+        }
+    }
+
+    void SetActiveContext(Context *context) {
+        activeContext = context;
+        VRVB::video_cb = ContextVideoCallback;
+        VRVB::audio_cb = ContextAudioCallback;
+    }
+
+    Context *ActiveContext() {
+        return activeContext;
+    }
+}
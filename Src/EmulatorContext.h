@@ -0,0 +1,72 @@
+#ifndef VB_EMULATOR_CONTEXT_H
+#define VB_EMULATOR_CONTEXT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Emulator {
+
+    const int VIDEO_WIDTH = 384;
+    const int VIDEO_HEIGHT = 224;
+
+    // size of the frames the core hands out, the right eye starts 12 lines below the left one
+    const int CORE_FRAME_SIZE = VIDEO_WIDTH * (VIDEO_HEIGHT * 2 + 12);
+    const int CORE_RIGHT_EYE_OFFSET = VIDEO_WIDTH * (VIDEO_HEIGHT + 12);
+
+    struct Rom {
+        std::string RomName;
+        std::string FullPath;
+        std::string FullPathNorm;
+        std::string SavePath;
+        // name of the rom inside the archive at FullPath, empty for plain rom files
+        std::string ArchiveEntry;
+        // ips or bps patch that gets applied after reading the rom, empty for unpatched roms
+        std::string PatchPath;
+    };
+
+    struct SaveState {
+        bool hasImage;
+        bool hasState;
+        // the state file is there but can not get loaded
+        bool stateBroken;
+        uint8_t *saveImage;
+    };
+
+    struct LoadedGame {
+        SaveState saveStates[10];
+    };
+
+    struct Context;
+
+    typedef void (*VideoCallback)(Context &context, const void *data, unsigned width, unsigned height);
+
+    typedef void (*AudioCallback)(Context &context, int16_t *samples, int32_t sampleCount);
+
+    // state of one emulator instance
+    // the core only exists once per process so only the active context gets driven by it;
+    // instances that should run at the same time need their own process (see BatchRunner)
+    struct Context {
+        std::vector<Rom> romFileList;
+        Rom *CurrentRom = nullptr;
+        LoadedGame *currentGame = nullptr;
+
+        float color[3]{1.0f, 1.0f, 1.0f};
+        int32_t *pixelData = nullptr;
+        uint8_t *screenData = nullptr;
+        const void *currentScreenData = nullptr;
+
+        uint32_t emulatedFrame = 0;
+        uint32_t currentRomHash = 0;
+
+        VideoCallback videoCallback = nullptr;
+        AudioCallback audioCallback = nullptr;
+    };
+
+    // routes the core callbacks to the given context
+    void SetActiveContext(Context *context);
+
+    Context *ActiveContext();
+}
+
+#endif
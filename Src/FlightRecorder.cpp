@@ -0,0 +1,164 @@
+#include "FlightRecorder.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+
+namespace FlightRecorder {
+
+    const uint32_t DUMP_MAGIC = 0x52464256;  // "VBFR"
+    const uint32_t DUMP_VERSION = 3;
+    const size_t SIGNAL_STACK_SIZE = 32 * 1024;
+
+    const int fatalSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    const int fatalSignalCount = sizeof(fatalSignals) / sizeof(int);
+
+    FrameRecord frameRing[FRAME_COUNT];
+    IoRecord ioRing[IO_COUNT];
+    std::atomic<uint32_t> framesWritten(0);
+    std::atomic<uint32_t> iosWritten(0);
+    uint32_t lastFrame;
+
+    // everything the handler needs is prepared up front, it may not allocate
+    char dumpFilePath[512];
+    struct sigaction previousActions[fatalSignalCount];
+
+    // turns the alternate stack off before it gets freed when the thread exits
+    struct ThreadStack {
+        std::unique_ptr<uint8_t[]> memory;
+
+        ~ThreadStack() {
+            if (!memory)
+                return;
+            stack_t stack;
+            memset(&stack, 0, sizeof(stack));
+            stack.ss_flags = SS_DISABLE;
+            sigaltstack(&stack, nullptr);
+        }
+    };
+
+    void WriteAll(int fd, const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *) data;
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written <= 0)
+                return;
+            bytes += written;
+            size -= written;
+        }
+    }
+
+    void SignalHandler(int signal, siginfo_t *info, void *context) {
+        int fd = open(dumpFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            DumpHeader header;
+            header.magic = DUMP_MAGIC;
+            header.version = DUMP_VERSION;
+            header.frameCount = FRAME_COUNT;
+            header.ioCount = IO_COUNT;
+            header.framesWritten = framesWritten.load(std::memory_order_acquire);
+            header.iosWritten = iosWritten.load(std::memory_order_acquire);
+            header.signal = signal;
+            header.reserved = 0;
+
+            WriteAll(fd, &header, sizeof(DumpHeader));
+            WriteAll(fd, frameRing, sizeof(frameRing));
+            WriteAll(fd, ioRing, sizeof(ioRing));
+            close(fd);
+        }
+
+        // hand the signal over to the previous handler (debuggerd) so the usual tombstone gets written
+        for (int i = 0; i < fatalSignalCount; ++i) {
+            if (fatalSignals[i] == signal)
+                sigaction(signal, &previousActions[i], nullptr);
+        }
+        raise(signal);
+    }
+
+    void Install(const std::string &dumpPath) {
+        strncpy(dumpFilePath, dumpPath.c_str(), sizeof(dumpFilePath) - 1);
+        InstallThread();
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        sigemptyset(&action.sa_mask);
+        action.sa_sigaction = SignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+
+        for (int i = 0; i < fatalSignalCount; ++i)
+            sigaction(fatalSignals[i], &action, &previousActions[i]);
+    }
+
+    void Uninstall() {
+        for (int i = 0; i < fatalSignalCount; ++i)
+            signal(fatalSignals[i], SIG_DFL);
+    }
+
+    void InstallThread() {
+        thread_local ThreadStack threadStack;
+        if (threadStack.memory)
+            return;
+
+        // a separate stack so that stack overflows can get recorded as well
+        threadStack.memory.reset(new uint8_t[SIGNAL_STACK_SIZE]);
+        stack_t stack;
+        stack.ss_sp = threadStack.memory.get();
+        stack.ss_size = SIGNAL_STACK_SIZE;
+        stack.ss_flags = 0;
+        sigaltstack(&stack, nullptr);
+    }
+
+    void RecordFrame(uint32_t frame, uint32_t input, uint32_t romHash, uint32_t costMicros, uint32_t deltaMicros, uint32_t flags) {
+        // only the emulator thread writes frames
+        uint32_t index = framesWritten.load(std::memory_order_relaxed);
+        FrameRecord &record = frameRing[index & (FRAME_COUNT - 1)];
+        record.frame = frame;
+        record.input = input;
+        record.romHash = romHash;
+        record.costMicros = costMicros;
+        record.deltaMicros = deltaMicros;
+        record.flags = flags;
+        lastFrame = frame;
+        framesWritten.store(index + 1, std::memory_order_release);
+    }
+
+    void RecordIo(IoType type, uint32_t bytes, uint32_t micros) {
+        uint32_t index = iosWritten.fetch_add(1, std::memory_order_acq_rel);
+        IoRecord &record = ioRing[index & (IO_COUNT - 1)];
+        record.frame = lastFrame;
+        record.type = type;
+        record.bytes = bytes;
+        record.micros = micros;
+    }
+
+    template<typename T>
+    void ReadRing(std::ifstream &file, uint32_t count, uint32_t written, std::vector<T> &records) {
+        std::vector<T> ring(count);
+        file.read((char *) ring.data(), count * sizeof(T));
+
+        uint32_t valid = written < count ? written : count;
+        records.clear();
+        records.reserve(valid);
+        for (uint32_t i = written - valid; i != written; ++i)
+            records.push_back(ring[i & (count - 1)]);
+    }
+
+    bool ReadDump(const std::string &path, Dump &dump) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        if (!file.read((char *) &dump.header, sizeof(DumpHeader)) || dump.header.magic != DUMP_MAGIC ||
+            dump.header.version != DUMP_VERSION || dump.header.frameCount != FRAME_COUNT || dump.header.ioCount != IO_COUNT)
+            return false;
+
+        ReadRing(file, FRAME_COUNT, dump.header.framesWritten, dump.frames);
+        ReadRing(file, IO_COUNT, dump.header.iosWritten, dump.ios);
+        return (bool) file;
+    }
+
+}  // namespace FlightRecorder
@@ -0,0 +1,92 @@
+#ifndef VB_FLIGHT_RECORDER_H
+#define VB_FLIGHT_RECORDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Always on recorder for the last frames and file operations. Recording only copies a few
+// words into preallocated rings; on a fatal signal the rings get written to disk so the
+// frames and inputs that led to a crash can be looked at or replayed.
+namespace FlightRecorder {
+
+    // both have to be a power of two
+    const uint32_t FRAME_COUNT = 4096;
+    const uint32_t IO_COUNT = 256;
+
+    enum IoType : uint32_t {
+        IoLoadRom = 1,
+        IoLoadRam,
+        IoSaveRam,
+        IoLoadState,
+        IoSaveState,
+        IoLoadStateImage,
+        IoSaveStateImage,
+        IoSnapshot
+    };
+
+    enum FrameFlags : uint32_t {
+        // the core ran every frame since power on (frame 0) with the recorded inputs only,
+        // no state got loaded and nothing else changed its memory, so the frames can get replayed
+        FrameFromPowerOn = 1
+    };
+
+    // one record per emulated frame, so fast forward and skipped display frames can get replayed as well
+    struct FrameRecord {
+        // emulated frame the input got used for
+        uint32_t frame;
+        uint32_t input;
+        uint32_t romHash;
+        // cost of the core and time since the previous emulated frame
+        uint32_t costMicros;
+        uint32_t deltaMicros;
+        uint32_t flags;
+    };
+
+    struct IoRecord {
+        uint32_t frame;
+        uint32_t type;
+        uint32_t bytes;
+        uint32_t micros;
+    };
+
+    struct DumpHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t frameCount;
+        uint32_t ioCount;
+        // total number of records written, the oldest valid one is at (written - count)
+        uint32_t framesWritten;
+        uint32_t iosWritten;
+        int32_t signal;
+        uint32_t reserved;
+    };
+
+    struct Dump {
+        DumpHeader header;
+        // oldest first
+        std::vector<FrameRecord> frames;
+        std::vector<IoRecord> ios;
+    };
+
+    // installs the handlers for fatal signals which write the rings to dumpPath
+    void Install(const std::string &dumpPath);
+
+    // the alternate stack the handler runs on is per thread; threads without one still get their crashes
+    // recorded but not their stack overflows, the workers of the other modules do not install one
+    void InstallThread();
+
+    // puts the default handlers back, forked processes must not write over the dump of their parent
+    void Uninstall();
+
+    void RecordFrame(uint32_t frame, uint32_t input, uint32_t romHash, uint32_t costMicros, uint32_t deltaMicros, uint32_t flags);
+
+    // can be called from any thread
+    void RecordIo(IoType type, uint32_t bytes, uint32_t micros);
+
+    // reads a dump written by the signal handler, the input words of the frames can be fed into a replay
+    bool ReadDump(const std::string &path, Dump &dump);
+
+}  // namespace FlightRecorder
+
+#endif
@@ -0,0 +1,256 @@
+#include "FrameExport.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__ANDROID__)
+#include <linux/ashmem.h>
+#endif
+
+#include "EmulatorContext.h"
+#include "MemoryTracker.h"
+#include "ScreenLayout.h"
+
+namespace FrameExport {
+
+    namespace {
+        const uint32_t EYE_SIZE = Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT;
+        const uint32_t SLOT_SIZE = sizeof(SlotHeader) + EYE_SIZE * 2;
+        const size_t MAPPING_SIZE = sizeof(RingHeader) + SLOT_SIZE * SLOT_COUNT;
+        // the publisher only answers once per frame, a paused game does not answer at all
+        const int READER_TIMEOUT_SECONDS = 2;
+        const char *const MEMORY_NAME = "vb frame export";
+
+        int CreateSharedMemory(size_t size) {
+#if defined(__ANDROID__)
+            // android 7 has neither ASharedMemory nor memfd_create, ashmem is what both of them are built on
+            int fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+            if (fd < 0)
+                return -1;
+            if (ioctl(fd, ASHMEM_SET_NAME, MEMORY_NAME) < 0 || ioctl(fd, ASHMEM_SET_SIZE, size) < 0) {
+                close(fd);
+                return -1;
+            }
+#else
+            int fd = (int) syscall(SYS_memfd_create, MEMORY_NAME, 1u /* MFD_CLOEXEC */);
+            if (fd < 0)
+                return -1;
+            if (ftruncate(fd, (off_t) size) != 0) {
+                close(fd);
+                return -1;
+            }
+#endif
+            return fd;
+        }
+
+        // abstract socket, it does not need a file and goes away with the publisher
+        socklen_t SocketAddress(const std::string &name, sockaddr_un &address) {
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            size_t length = std::min(name.size(), sizeof(address.sun_path) - 1);
+            memcpy(address.sun_path + 1, name.data(), length);
+            return (socklen_t) (offsetof(sockaddr_un, sun_path) + 1 + length);
+        }
+
+        // the size goes along with the descriptor, fstat does not report it for ashmem
+        bool SendMemory(int socket, int memoryFd, uint64_t size) {
+            iovec data = {&size, sizeof(size)};
+            char control[CMSG_SPACE(sizeof(int))] = {};
+            msghdr message = {};
+            message.msg_iov = &data;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(header), &memoryFd, sizeof(int));
+            return sendmsg(socket, &message, MSG_NOSIGNAL) == (ssize_t) sizeof(size);
+        }
+
+        int ReceiveMemory(int socket, uint64_t &size) {
+            iovec data = {&size, sizeof(size)};
+            char control[CMSG_SPACE(sizeof(int))] = {};
+            msghdr message = {};
+            message.msg_iov = &data;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != (ssize_t) sizeof(size))
+                return -1;
+
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+                return -1;
+            int fd;
+            memcpy(&fd, CMSG_DATA(header), sizeof(int));
+            return fd;
+        }
+    }
+
+    Publisher::~Publisher() {
+        Close();
+    }
+
+    bool Publisher::Open(const std::string &socketName) {
+        Close();
+
+        memoryFd = CreateSharedMemory(MAPPING_SIZE);
+        if (memoryFd < 0)
+            return false;
+
+        sockaddr_un address;
+        socklen_t addressSize = SocketAddress(socketName, address);
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        void *memory = mmap(nullptr, MAPPING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+        if (listenFd < 0 || bind(listenFd, (const sockaddr *) &address, addressSize) != 0 || listen(listenFd, 4) != 0 ||
+            memory == MAP_FAILED) {
+            if (memory != MAP_FAILED)
+                munmap(memory, MAPPING_SIZE);
+            if (listenFd >= 0)
+                close(listenFd);
+            close(memoryFd);
+            listenFd = memoryFd = -1;
+            return false;
+        }
+        mapping = (uint8_t *) memory;
+        mappingSize = MAPPING_SIZE;
+        MemoryTracker::Allocated(MemoryTracker::TagVideo, mappingSize);
+
+        // readers check the magic last
+        header = (RingHeader *) mapping;
+        header->magic = 0;
+        header->version = VERSION;
+        header->slotCount = SLOT_COUNT;
+        header->slotSize = SLOT_SIZE;
+        header->width = Emulator::VIDEO_WIDTH;
+        header->height = Emulator::VIDEO_HEIGHT;
+        header->published.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i)
+            ((SlotHeader *) (mapping + sizeof(RingHeader) + i * SLOT_SIZE))->sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = MAGIC;
+        return true;
+    }
+
+    void Publisher::Close() {
+        if (!mapping)
+            return;
+
+        MemoryTracker::Freed(MemoryTracker::TagVideo, mappingSize);
+        munmap(mapping, mappingSize);
+        close(listenFd);
+        close(memoryFd);
+        mapping = nullptr;
+        header = nullptr;
+        listenFd = memoryFd = -1;
+    }
+
+    void Publisher::Serve() {
+        int client;
+        while ((client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+            SendMemory(client, memoryFd, mappingSize);
+            close(client);
+        }
+    }
+
+    void Publisher::Publish(const uint8_t *frame, uint32_t frameNumber, uint32_t input) {
+        if (!header)
+            return;
+
+        uint32_t published = header->published.load(std::memory_order_relaxed);
+        uint8_t *slotData = mapping + sizeof(RingHeader) + (published % SLOT_COUNT) * SLOT_SIZE;
+        SlotHeader *slot = (SlotHeader *) slotData;
+
+        uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->frame = frameNumber;
+        slot->input = input;
+        ScreenLayout::CopyEyes(frame, slotData + sizeof(SlotHeader));
+
+        slot->sequence.store(sequence + 2, std::memory_order_release);
+        header->published.store(published + 1, std::memory_order_release);
+
+        Serve();
+    }
+
+    Reader::~Reader() {
+        Close();
+    }
+
+    bool Reader::Open(const std::string &socketName) {
+        Close();
+
+        sockaddr_un address;
+        socklen_t addressSize = SocketAddress(socketName, address);
+        int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connection < 0)
+            return false;
+        timeval timeout = {READER_TIMEOUT_SECONDS, 0};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        uint64_t size = 0;
+        int fd = connect(connection, (const sockaddr *) &address, addressSize) == 0 ? ReceiveMemory(connection, size) : -1;
+        close(connection);
+        if (fd < 0)
+            return false;
+
+        void *memory = size >= sizeof(RingHeader) ? mmap(nullptr, (size_t) size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (memory == MAP_FAILED)
+            return false;
+        mapping = (uint8_t *) memory;
+        mappingSize = (size_t) size;
+
+        header = (const RingHeader *) mapping;
+        if (header->magic != MAGIC || header->version != VERSION ||
+            mappingSize < sizeof(RingHeader) + (size_t) header->slotSize * header->slotCount) {
+            Close();
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    void Reader::Close() {
+        if (!mapping)
+            return;
+
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        header = nullptr;
+    }
+
+    bool Reader::Latest(FrameView &view) const {
+        if (!header)
+            return false;
+
+        uint32_t published = header->published.load(std::memory_order_acquire);
+        if (published == 0)
+            return false;
+
+        const uint8_t *slotData = mapping + sizeof(RingHeader) + ((published - 1) % header->slotCount) * header->slotSize;
+        view.slot = (const SlotHeader *) slotData;
+        view.sequence = view.slot->sequence.load(std::memory_order_acquire);
+        if (view.sequence & 1)
+            return false;
+
+        view.frame = view.slot->frame;
+        view.input = view.slot->input;
+        view.eyes = slotData + sizeof(SlotHeader);
+        return true;
+    }
+
+}  // namespace FrameExport
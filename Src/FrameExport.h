@@ -0,0 +1,123 @@
+#ifndef VB_FRAME_EXPORT_H
+#define VB_FRAME_EXPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Publishes the core frames (8 bit, both eyes) and the input word into shared memory so other
+// local processes can follow the game without going through the vr renderer. The memory is
+// anonymous (ashmem, memfd on desktop linux) so rewriting it every frame never reaches the flash;
+// readers connect to the abstract unix socket SOCKET_NAME and get the descriptor passed over it.
+//
+// The memory holds a RingHeader followed by SLOT_COUNT slots. Every slot is guarded by a sequence
+// counter (seqlock): the producer makes it odd, copies the frame and makes it even again, it never
+// waits for readers. A reader reads the slot in place and only uses the data when the sequence is
+// even and unchanged afterwards:
+//
+//     FrameExport::Reader reader;
+//     reader.Open(FrameExport::SOCKET_NAME);
+//     FrameExport::FrameView view;
+//     if (reader.Latest(view)) {
+//         ... use view.eyes ...
+//         if (!reader.Valid(view)) { the producer overwrote the slot, drop what was read }
+//     }
+//
+// vbframes (FrameExportMain.cpp) is a small consumer that follows the ring and reports the throughput.
+namespace FrameExport {
+
+    const uint32_t MAGIC = 0x58454256;  // "VBEX"
+    const uint32_t VERSION = 1;
+    const uint32_t SLOT_COUNT = 8;
+    const char *const SOCKET_NAME = "virtualboygo.frames";
+
+    struct RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;
+        uint32_t width;
+        // height of one eye, the right eye follows the left one
+        uint32_t height;
+        // number of published frames, the newest one is in slot (published - 1) % slotCount
+        std::atomic<uint32_t> published;
+        uint32_t reserved;
+    };
+
+    struct SlotHeader {
+        // odd while the slot gets written
+        std::atomic<uint32_t> sequence;
+        uint32_t frame;
+        uint32_t input;
+        uint32_t reserved;
+    };
+
+    struct FrameView {
+        const uint8_t *eyes;
+        uint32_t frame;
+        uint32_t input;
+        uint32_t sequence;
+        const SlotHeader *slot;
+    };
+
+    class Publisher {
+    public:
+        ~Publisher();
+
+        // creates the shared memory and starts listening on the socket
+        bool Open(const std::string &socketName);
+
+        void Close();
+
+        bool IsOpen() const { return header != nullptr; }
+
+        // frame in the layout the core hands out, also hands the memory to readers that connected since the last frame
+        void Publish(const uint8_t *frame, uint32_t frameNumber, uint32_t input);
+
+    private:
+        void Serve();
+
+        RingHeader *header = nullptr;
+        uint8_t *mapping = nullptr;
+        size_t mappingSize = 0;
+        int memoryFd = -1;
+        int listenFd = -1;
+    };
+
+    class Reader {
+    public:
+        ~Reader();
+
+        // gets the memory from the publisher listening on socketName, fails if no frame gets published for a while
+        bool Open(const std::string &socketName);
+
+        void Close();
+
+        // newest frame that is not being written right now
+        bool Latest(FrameView &view) const;
+
+        // true if the slot was not touched while the view was used
+        bool Valid(const FrameView &view) const {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+        }
+
+        // size of one eye, the right eye follows the left one in view.eyes
+        void Size(uint32_t &width, uint32_t &height) const {
+            width = header ? header->width : 0;
+            height = header ? header->height : 0;
+        }
+
+        // number of frames published so far, can be used to detect missed frames
+        uint32_t Published() const { return header ? header->published.load(std::memory_order_acquire) : 0; }
+
+    private:
+        const RingHeader *header = nullptr;
+        uint8_t *mapping = nullptr;
+        size_t mappingSize = 0;
+    };
+
+}  // namespace FrameExport
+
+#endif
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "FrameExport.h"
+
+// vbframes [seconds] [pgm path] [socket name]
+// follows the frames the emulator publishes while frame export is turned on and a game is running,
+// prints how many frames arrived, got missed or were overwritten while being read every second and
+// writes the last frame as a pgm with the left eye above the right one
+
+namespace {
+
+    struct Counters {
+        uint32_t received;
+        uint32_t missed;
+        uint32_t torn;
+        uint64_t bytes;
+    };
+
+    void PrintCounters(const Counters &counters, double seconds) {
+        printf("%u frames (%.1f/s, %.1f MB/s), %u missed, %u torn\n", counters.received, counters.received / seconds,
+               counters.bytes / seconds / (1024 * 1024), counters.missed, counters.torn);
+    }
+
+    bool WritePgm(const char *path, const uint8_t *eyes, uint32_t width, uint32_t height) {
+        FILE *file = fopen(path, "wb");
+        if (!file)
+            return false;
+        fprintf(file, "P5\n%u %u\n255\n", width, height * 2);
+        bool written = fwrite(eyes, 1, (size_t) width * height * 2, file) == (size_t) width * height * 2;
+        return fclose(file) == 0 && written;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && atof(argv[1]) <= 0) {
+        fprintf(stderr, "usage: %s [seconds] [pgm path] [socket name]\n", argv[0]);
+        return 2;
+    }
+    double duration = argc > 1 ? atof(argv[1]) : 10;
+    const char *pgmPath = argc > 2 ? argv[2] : nullptr;
+    const char *socketName = argc > 3 ? argv[3] : FrameExport::SOCKET_NAME;
+
+    FrameExport::Reader reader;
+    if (!reader.Open(socketName)) {
+        fprintf(stderr, "could not connect to @%s, frame export has to be turned on and a game running\n", socketName);
+        return 1;
+    }
+
+    // the size is fixed by the publisher, the copy only gets used once the slot turned out to be valid
+    std::vector<uint8_t> eyes, lastEyes;
+    uint32_t width = 0, height = 0;
+
+    Counters total = {}, interval = {};
+    uint32_t lastPublished = reader.Published();
+    auto startTime = std::chrono::steady_clock::now();
+    auto intervalStart = startTime;
+
+    while (std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() < duration) {
+        uint32_t published = reader.Published();
+        FrameExport::FrameView view;
+        if (published == lastPublished || !reader.Latest(view)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        } else {
+            reader.Size(width, height);
+            eyes.resize((size_t) width * height * 2);
+            memcpy(eyes.data(), view.eyes, eyes.size());
+
+            if (reader.Valid(view)) {
+                // the publisher can get ahead of the reader by more than one frame
+                interval.missed += published - lastPublished - 1;
+                interval.received++;
+                interval.bytes += eyes.size();
+                lastEyes.swap(eyes);
+            } else {
+                interval.torn++;
+            }
+            lastPublished = published;
+        }
+
+        auto time = std::chrono::steady_clock::now();
+        double intervalSeconds = std::chrono::duration<double>(time - intervalStart).count();
+        if (intervalSeconds >= 1) {
+            PrintCounters(interval, intervalSeconds);
+            total.received += interval.received;
+            total.missed += interval.missed;
+            total.torn += interval.torn;
+            total.bytes += interval.bytes;
+            interval = Counters();
+            intervalStart = time;
+        }
+    }
+
+    total.received += interval.received;
+    total.missed += interval.missed;
+    total.torn += interval.torn;
+    total.bytes += interval.bytes;
+    printf("total: ");
+    PrintCounters(total, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+
+    if (pgmPath && !lastEyes.empty() && !WritePgm(pgmPath, lastEyes.data(), width, height)) {
+        fprintf(stderr, "could not write %s\n", pgmPath);
+        return 1;
+    }
+    return total.received > 0 ? 0 : 1;
+}
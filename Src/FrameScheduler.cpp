@@ -0,0 +1,72 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    double Now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+void FrameScheduler::Post(const std::string &key, Priority priority, Task task) {
+    stats.posted++;
+
+    for (Entry &entry : tasks) {
+        if (entry.key == key) {
+            // the new task replaces the old one but keeps its place in the queue
+            entry.task = task;
+            entry.priority = std::min(entry.priority, priority);
+            stats.coalesced++;
+            return;
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.priority = priority;
+    entry.task = task;
+    entry.postTime = Now();
+    entry.order = nextOrder++;
+    tasks.push_back(entry);
+}
+
+void FrameScheduler::Run(double budgetSeconds) {
+    double start = Now();
+
+    while (!tasks.empty()) {
+        double now = Now();
+
+        // highest priority first, in the order they were posted
+        std::vector<Entry>::iterator next = std::min_element(tasks.begin(), tasks.end(), [](const Entry &a, const Entry &b) {
+            return a.priority != b.priority ? a.priority < b.priority : a.order < b.order;
+        });
+
+        // tasks that waited too long run even without time left, so a busy frame rate can not starve them
+        bool timeLeft = now - start < budgetSeconds;
+        std::vector<Entry>::iterator oldest = std::min_element(tasks.begin(), tasks.end(), [](const Entry &a, const Entry &b) {
+            return a.postTime < b.postTime;
+        });
+        if (!timeLeft) {
+            if (now - oldest->postTime < maxWait)
+                return;
+            next = oldest;
+            stats.forced++;
+        }
+
+        stats.maxDelay = std::max(stats.maxDelay, now - next->postTime);
+        stats.chunks++;
+
+        // the task could post new tasks, so it has to be taken out before it runs
+        Entry entry = *next;
+        tasks.erase(next);
+        bool done = entry.task();
+        // a newer request for the same key makes the rest of this one pointless
+        bool replaced = std::any_of(tasks.begin(), tasks.end(), [&](const Entry &other) { return other.key == entry.key; });
+        if (!done && !replaced)
+            tasks.push_back(entry);
+
+        if (!timeLeft)
+            return;
+    }
+}
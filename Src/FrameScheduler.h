@@ -0,0 +1,61 @@
+#ifndef VB_FRAME_SCHEDULER_H
+#define VB_FRAME_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Work that does not have to happen on the frame that asked for it. The tasks run on the gl
+// thread in the time that is left of the frame after the emulation, bigger jobs get split into
+// chunks that each run on their own frame.
+class FrameScheduler {
+public:
+    enum Priority {
+        PriorityHigh = 0,
+        PriorityNormal,
+        PriorityLow
+    };
+
+    // returns true once the task is done, false to get called again with the next chunk
+    typedef std::function<bool()> Task;
+
+    struct Stats {
+        uint32_t posted;
+        uint32_t coalesced;
+        uint32_t chunks;
+        // tasks that had to run without time left because they waited too long
+        uint32_t forced;
+        double maxDelay;
+    };
+
+    // a queued task with the same key gets replaced, so repeated requests only run once
+    void Post(const std::string &key, Priority priority, Task task);
+
+    // runs tasks for at most the given time
+    void Run(double budgetSeconds);
+
+    bool IsEmpty() const { return tasks.empty(); }
+
+    Stats GetStats() const { return stats; }
+
+    void ClearStats() { stats = Stats(); }
+
+    // how long a task may wait before it runs even without time left
+    double maxWait = 0.1;
+
+private:
+    struct Entry {
+        std::string key;
+        Priority priority;
+        Task task;
+        double postTime;
+        uint64_t order;
+    };
+
+    std::vector<Entry> tasks;
+    uint64_t nextOrder = 0;
+    Stats stats = {};
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "PerformanceGovernor.h"
+
+// vbgovernor [trace]
+// feeds synthetic frame time traces to the performance governor and checks that it raises the
+// clocks, degrades, gives back quality and lowers the clocks again in the expected windows. A
+// recorded trace with one "<frame cost ms> <delta ms> <temperature>" line per frame gets played
+// back instead, printing every change the governor makes.
+
+namespace {
+
+    struct Phase {
+        int windows;
+        // relative to the frame period
+        float cost;
+        // every nth frame comes too late, 0 for none
+        int staleEvery;
+        float temperature;
+    };
+
+    struct Transition {
+        int window;
+        int cpuLevel;
+        int gpuLevel;
+        PerformanceGovernor::DegradeLevel degradeLevel;
+    };
+
+    struct Scenario {
+        const char *name;
+        std::vector<Phase> phases;
+        std::vector<Transition> expected;
+    };
+
+    using PerformanceGovernor::DegradeNone;
+    using PerformanceGovernor::DegradeSkipUpscale;
+    using PerformanceGovernor::DegradeMono;
+    using PerformanceGovernor::DegradeFrameskip;
+
+    // default config: windows of 72 frames, 5 calm windows to recover, clocks between 0 and 4 starting at 2
+    std::vector<Scenario> Scenarios() {
+        return {
+                {"cpu bound, then idle",
+                 {{10, 0.8f, 0, 30}, {40, 0.1f, 0, 30}},
+                 {{1, 3, 2, DegradeNone}, {2, 4, 2, DegradeNone}, {3, 4, 2, DegradeSkipUpscale}, {4, 4, 2, DegradeMono},
+                  {5, 4, 2, DegradeFrameskip},
+                  {15, 4, 2, DegradeMono}, {20, 4, 2, DegradeSkipUpscale}, {25, 4, 2, DegradeNone}, {30, 4, 1, DegradeNone},
+                  {35, 4, 0, DegradeNone}, {40, 3, 0, DegradeNone}, {45, 2, 0, DegradeNone}, {50, 1, 0, DegradeNone}}},
+                {"gpu bound, then normal",
+                 {{5, 0.1f, 10, 30}, {10, 0.1f, 0, 30}},
+                 {{1, 2, 3, DegradeNone}, {2, 2, 4, DegradeNone}, {3, 2, 4, DegradeSkipUpscale}, {4, 2, 4, DegradeMono},
+                  {5, 2, 4, DegradeFrameskip}, {10, 2, 4, DegradeMono}, {15, 2, 4, DegradeSkipUpscale}}},
+                // hot devices degrade right away and only give back clocks, never quality
+                {"hot and cpu bound, then moderate",
+                 {{3, 0.8f, 0, 45}, {20, 0.3f, 0, 45}},
+                 {{1, 2, 2, DegradeSkipUpscale}, {2, 2, 2, DegradeMono}, {3, 2, 2, DegradeFrameskip},
+                  {8, 2, 1, DegradeFrameskip}, {13, 2, 0, DegradeFrameskip}, {18, 1, 0, DegradeFrameskip},
+                  {23, 0, 0, DegradeFrameskip}}},
+                // a load between the thresholds is neither pressure nor headroom
+                {"steady load", {{30, 0.35f, 0, 30}}, {}},
+                // a few late frames stay under the stale limit, but they keep the clocks up
+                {"occasional hitches", {{30, 0.1f, 30, 30}}, {}},
+        };
+    }
+
+    // small deterministic noise, well inside the thresholds
+    float Noise(uint32_t &seed) {
+        seed = seed * 1103515245u + 12345u;
+        return ((seed >> 16) % 1000) / 1000.0f * 0.1f - 0.05f;
+    }
+
+    void PrintTransition(const Transition &transition) {
+        printf("  window %i: cpu %i, gpu %i, degrade %s\n", transition.window, transition.cpuLevel, transition.gpuLevel,
+               PerformanceGovernor::DegradeName(transition.degradeLevel).c_str());
+    }
+
+    bool RunScenario(const Scenario &scenario) {
+        PerformanceGovernor::Config config;
+        PerformanceGovernor::State state;
+        PerformanceGovernor::Reset(state, config);
+
+        std::vector<Transition> transitions;
+        uint32_t seed = 1;
+        int window = 0;
+        for (const Phase &phase : scenario.phases) {
+            for (int i = 0; i < phase.windows; ++i) {
+                window++;
+                for (int frame = 0; frame < config.windowSize; ++frame) {
+                    PerformanceGovernor::Sample sample;
+                    sample.frameCost = (phase.cost + Noise(seed)) * config.framePeriod;
+                    bool stale = phase.staleEvery > 0 && frame % phase.staleEvery == 0;
+                    sample.deltaSeconds = config.framePeriod * (stale ? 2 : 1);
+                    sample.temperature = phase.temperature;
+                    if (PerformanceGovernor::Update(state, config, sample))
+                        transitions.push_back({window, state.cpuLevel, state.gpuLevel, state.degradeLevel});
+                }
+            }
+        }
+
+        bool matched = transitions.size() == scenario.expected.size();
+        for (size_t i = 0; matched && i < transitions.size(); ++i) {
+            const Transition &actual = transitions[i], &expected = scenario.expected[i];
+            matched = actual.window == expected.window && actual.cpuLevel == expected.cpuLevel &&
+                      actual.gpuLevel == expected.gpuLevel && actual.degradeLevel == expected.degradeLevel;
+        }
+
+        printf("%s: %s\n", scenario.name, matched ? "ok" : "FAILED");
+        if (!matched) {
+            printf(" expected:\n");
+            for (const Transition &transition : scenario.expected)
+                PrintTransition(transition);
+            printf(" got:\n");
+            for (const Transition &transition : transitions)
+                PrintTransition(transition);
+        }
+        return matched;
+    }
+
+    bool PlayTrace(const char *path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            fprintf(stderr, "could not open %s\n", path);
+            return false;
+        }
+
+        PerformanceGovernor::Config config;
+        PerformanceGovernor::State state;
+        PerformanceGovernor::Reset(state, config);
+
+        int frame = 0;
+        float costMs, deltaMs, temperature;
+        while (file >> costMs >> deltaMs >> temperature) {
+            PerformanceGovernor::Sample sample;
+            sample.frameCost = costMs / 1000;
+            sample.deltaSeconds = deltaMs / 1000;
+            sample.temperature = temperature;
+            frame++;
+            if (PerformanceGovernor::Update(state, config, sample))
+                printf("frame %i: cpu %i, gpu %i, degrade %s, temp %.1f\n", frame, state.cpuLevel, state.gpuLevel,
+                       PerformanceGovernor::DegradeName(state.degradeLevel).c_str(), state.temperature);
+        }
+        printf("%i frames\n", frame);
+        return frame > 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1)
+        return PlayTrace(argv[1]) ? 0 : 1;
+
+    bool passed = true;
+    for (const Scenario &scenario : Scenarios())
+        passed &= RunScenario(scenario);
+    printf("%s\n", passed ? "all passed" : "failed");
+    return passed ? 0 : 1;
+}
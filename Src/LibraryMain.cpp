@@ -0,0 +1,294 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "RemoteLibrary.h"
+#include "RomCache.h"
+
+// vblibrary [kb per second] [rom kb]
+// serves a manifest and a generated rom from a local http server that only sends the given amount
+// of data per second and downloads the rom through the library. A second round gives the library a
+// manifest entry bigger than MAX_ROM_SIZE, a file on the server with another size than the manifest
+// says, a response that breaks off before its Content-Length and a server without range support
+// that sends more than any rom can be; all of them have to fail without taking the memory for them.
+
+namespace {
+
+    enum ServeMode {
+        ServeNormal,
+        // Content-Range says the file is bigger than it is
+        ServeWrongTotal,
+        // closes the connection halfway through the body
+        ServeBrokenOff,
+        // ignores the range and always sends the whole file
+        ServeNoRange
+    };
+
+    struct File {
+        std::vector<uint8_t> data;
+        ServeMode mode;
+        bool throttled;
+    };
+
+    // one connection at a time, http 1.0 with range requests
+    class ThrottledServer {
+    public:
+        bool Start(uint32_t bytesPerSecond) {
+            this->bytesPerSecond = bytesPerSecond;
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (listenFd < 0)
+                return false;
+
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t addressSize = sizeof(address);
+            if (bind(listenFd, (sockaddr *) &address, addressSize) != 0 || listen(listenFd, 4) != 0 ||
+                getsockname(listenFd, (sockaddr *) &address, &addressSize) != 0)
+                return false;
+
+            port = ntohs(address.sin_port);
+            thread = std::thread(&ThrottledServer::Run, this);
+            return true;
+        }
+
+        void Stop() {
+            stopping = true;
+            shutdown(listenFd, SHUT_RDWR);
+            close(listenFd);
+            if (thread.joinable())
+                thread.join();
+        }
+
+        std::string Url(const std::string &path) const { return "http://127.0.0.1:" + std::to_string(port) + "/" + path; }
+
+        void Add(const std::string &path, const std::vector<uint8_t> &data, ServeMode mode, bool throttled) {
+            files["/" + path] = File{data, mode, throttled};
+        }
+
+        std::atomic<uint64_t> sentBytes{0};
+
+    private:
+        void Run() {
+            while (!stopping) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0)
+                    continue;
+                Serve(fd);
+                close(fd);
+            }
+        }
+
+        void Serve(int fd) {
+            std::string request;
+            char buffer[1024];
+            ssize_t received;
+            while (request.find("\r\n\r\n") == std::string::npos && (received = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+                request.append(buffer, (size_t) received);
+
+            char path[256] = {};
+            sscanf(request.c_str(), "GET %255s", path);
+            std::map<std::string, File>::const_iterator file = files.find(path);
+            if (file == files.end()) {
+                Send(fd, "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n", false);
+                return;
+            }
+
+            const std::vector<uint8_t> &data = file->second.data;
+            uint64_t first = 0, last = data.size() - 1;
+            size_t range = request.find("Range: bytes=");
+            bool partial = range != std::string::npos && file->second.mode != ServeNoRange;
+            if (partial && sscanf(request.c_str() + range, "Range: bytes=%llu-%llu", (unsigned long long *) &first,
+                                  (unsigned long long *) &last) == 2)
+                last = std::min(last, (uint64_t) data.size() - 1);
+
+            uint64_t total = data.size() + (file->second.mode == ServeWrongTotal ? 1024 : 0);
+            std::ostringstream header;
+            if (partial)
+                header << "HTTP/1.0 206 Partial Content\r\nContent-Range: bytes " << first << "-" << last << "/" << total << "\r\n";
+            else
+                header << "HTTP/1.0 200 OK\r\n";
+            header << "Content-Length: " << (last - first + 1) << "\r\n\r\n";
+
+            std::string response = header.str();
+            uint64_t length = last - first + 1;
+            if (file->second.mode == ServeBrokenOff)
+                length /= 2;
+            response.append((const char *) data.data() + first, (size_t) length);
+            Send(fd, response, file->second.throttled);
+        }
+
+        // sends in slices of 10ms worth of data
+        void Send(int fd, const std::string &response, bool throttled) {
+            size_t slice = throttled ? std::max<size_t>(bytesPerSecond / 100, 1) : response.size();
+            auto sendTime = std::chrono::steady_clock::now();
+            for (size_t offset = 0; offset < response.size() && !stopping; offset += slice) {
+                size_t length = std::min(slice, response.size() - offset);
+                if (send(fd, response.data() + offset, length, MSG_NOSIGNAL) != (ssize_t) length)
+                    return;
+                sentBytes += length;
+                sendTime += std::chrono::milliseconds(10);
+                if (throttled)
+                    std::this_thread::sleep_until(sendTime);
+            }
+        }
+
+        int listenFd = -1;
+        uint16_t port = 0;
+        uint32_t bytesPerSecond = 0;
+        std::atomic<bool> stopping{false};
+        std::thread thread;
+        std::map<std::string, File> files;
+    };
+
+    std::vector<uint8_t> GeneratedRom(uint32_t size, uint32_t seed) {
+        std::vector<uint8_t> data(size);
+        uint32_t value = seed;
+        for (uint8_t &byte : data) {
+            value = value * 1103515245u + 12345u;
+            byte = (uint8_t) (value >> 16);
+        }
+        return data;
+    }
+
+    uint32_t Crc(const std::vector<uint8_t> &data) { return (uint32_t) crc32(0, data.data(), (uInt) data.size()); }
+
+    std::string ManifestLine(uint32_t crc, uint64_t size, const std::string &path) {
+        char line[64];
+        snprintf(line, sizeof(line), "%08x %llu ", crc, (unsigned long long) size);
+        return line + path + "\n";
+    }
+
+    bool WaitForEntries(RemoteLibrary::Library &library, std::vector<RemoteLibrary::Entry> &entries) {
+        auto startTime = std::chrono::steady_clock::now();
+        while (!library.TakeEntries(entries)) {
+            if (std::chrono::steady_clock::now() - startTime > std::chrono::seconds(10))
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    bool FindEntry(const std::vector<RemoteLibrary::Entry> &entries, const std::string &name, RemoteLibrary::Entry &entry) {
+        for (const RemoteLibrary::Entry &current : entries) {
+            if (current.Url.size() >= name.size() && current.Url.compare(current.Url.size() - name.size(), name.size(), name) == 0) {
+                entry = current;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Check(bool condition, const char *name) {
+        printf("%s: %s\n", name, condition ? "ok" : "FAILED");
+        return condition;
+    }
+}
+
+int main(int argc, char **argv) {
+    if ((argc > 1 && atoi(argv[1]) <= 0) || (argc > 2 && atoi(argv[2]) <= 0)) {
+        fprintf(stderr, "usage: %s [kb per second] [rom kb]\n", argv[0]);
+        return 2;
+    }
+    uint32_t bytesPerSecond = (uint32_t) (argc > 1 ? atoi(argv[1]) : 2048) * 1024;
+    uint32_t romSize = (uint32_t) (argc > 2 ? atoi(argv[2]) : 1024) * 1024;
+
+    char folder[] = "/tmp/vblibraryXXXXXX";
+    if (!mkdtemp(folder)) {
+        fprintf(stderr, "could not create a temporary folder\n");
+        return 1;
+    }
+    std::string cacheFolder = std::string(folder) + "/cache/";
+    std::string manifestCachePath = std::string(folder) + "/manifest.txt";
+
+    std::vector<uint8_t> rom = GeneratedRom(romSize, 1);
+    std::vector<uint8_t> resized = GeneratedRom(romSize, 2);
+    std::vector<uint8_t> broken = GeneratedRom(romSize, 3);
+    std::vector<uint8_t> huge = GeneratedRom(RemoteLibrary::MAX_ROM_SIZE + 1024 * 1024, 4);
+
+    // the limit only matters for the download that gets timed, the failing ones run at full speed
+    ThrottledServer server;
+    if (!server.Start(bytesPerSecond)) {
+        fprintf(stderr, "could not start the server\n");
+        return 1;
+    }
+    server.Add("game.vb", rom, ServeNormal, true);
+    server.Add("resized.vb", resized, ServeWrongTotal, false);
+    server.Add("broken.vb", broken, ServeBrokenOff, false);
+    server.Add("huge.vb", huge, ServeNoRange, false);
+
+    std::string manifest = ManifestLine(Crc(rom), rom.size(), "game.vb") +
+                           ManifestLine(Crc(resized), resized.size(), "resized.vb") +
+                           ManifestLine(Crc(broken), broken.size(), "broken.vb") +
+                           ManifestLine(Crc(huge), (uint64_t) RemoteLibrary::MAX_ROM_SIZE + 1, "oversized.vb") +
+                           ManifestLine(0x12345678, 0xFFFFFFFFu, "lying.vb");
+    server.Add("manifest.txt", std::vector<uint8_t>(manifest.begin(), manifest.end()), ServeNormal, true);
+
+    RomCache cache;
+    cache.Init(cacheFolder, 64 * 1024 * 1024);
+
+    bool passed = true;
+    {
+        RemoteLibrary::Library library(cache);
+        library.Open(server.Url("manifest.txt"), manifestCachePath);
+
+        std::vector<RemoteLibrary::Entry> entries;
+        passed &= Check(WaitForEntries(library, entries), "manifest");
+        RemoteLibrary::Entry entry;
+        passed &= Check(entries.size() == 3 && !FindEntry(entries, "oversized.vb", entry) && !FindEntry(entries, "lying.vb", entry),
+                        "entries over MAX_ROM_SIZE left out");
+
+        // the manifest gets written next to the cache once the worker is done with it
+        std::ifstream cached;
+        for (int i = 0; i < 200 && !cached.is_open(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            cached.open(manifestCachePath);
+        }
+        std::stringstream cachedText;
+        cachedText << cached.rdbuf();
+        passed &= Check(cachedText.str() == manifest && access((manifestCachePath + ".tmp").c_str(), F_OK) != 0,
+                        "manifest cache replaced");
+
+        std::vector<uint8_t> data;
+        uint64_t sentBefore = server.sentBytes;
+        auto startTime = std::chrono::steady_clock::now();
+        bool fetched = FindEntry(entries, "game.vb", entry) && library.Fetch(entry, data);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        printf("%u kb in %.2fs (%.0f kb/s, %llu bytes sent)\n", romSize / 1024, seconds, romSize / 1024 / seconds,
+               (unsigned long long) (server.sentBytes - sentBefore));
+        passed &= Check(fetched && data == rom, "throttled download");
+
+        passed &= Check(FindEntry(entries, "resized.vb", entry) && !library.Fetch(entry, data), "other size on the server refused");
+        passed &= Check(FindEntry(entries, "broken.vb", entry) && !library.Fetch(entry, data), "broken off response refused");
+
+        // a manifest entry that did not come through ParseManifest
+        entry.Url = server.Url("huge.vb");
+        entry.crc = Crc(huge);
+        entry.size = RemoteLibrary::MAX_ROM_SIZE + 1;
+        passed &= Check(!library.Fetch(entry, data), "rom over MAX_ROM_SIZE refused");
+
+        std::vector<uint8_t> body;
+        passed &= Check(!RemoteLibrary::HttpGet(server.Url("huge.vb"), 0, 1024, body) && body.empty(),
+                        "response over the limit refused");
+    }
+
+    server.Stop();
+    std::string command = std::string("rm -rf ") + folder;
+    if (system(command.c_str()) != 0)
+        fprintf(stderr, "could not remove %s\n", folder);
+
+    printf("%s\n", passed ? "all passed" : "failed");
+    return passed ? 0 : 1;
+}
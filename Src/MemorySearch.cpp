@@ -0,0 +1,134 @@
+#include "MemorySearch.h"
+
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEMORY_SEARCH_NEON
+#endif
+
+namespace MemorySearch {
+
+    namespace {
+        const size_t BLOCK_SIZE = 64;
+
+        inline bool CompareByte(Compare compare, uint8_t current, uint8_t last, uint8_t value) {
+            switch (compare) {
+                case CompareEqual:
+                    return current == last;
+                case CompareChanged:
+                    return current != last;
+                case CompareGreater:
+                    return current > last;
+                case CompareLess:
+                    return current < last;
+                default:
+                    return current == value;
+            }
+        }
+
+        uint64_t CompareScalar(Compare compare, const uint8_t *current, const uint8_t *last, uint8_t value, size_t count) {
+            uint64_t mask = 0;
+            for (size_t i = 0; i < count; ++i)
+                if (CompareByte(compare, current[i], last[i], value))
+                    mask |= 1ull << i;
+            return mask;
+        }
+
+#ifdef MEMORY_SEARCH_NEON
+        // one bit per lane, lane 0 ends up in the lowest bit
+        inline uint64_t MoveMask(uint8x16_t mask) {
+            static const uint8_t laneBits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+            uint8x16_t bits = vandq_u8(mask, vld1q_u8(laneBits));
+            uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+            sum = vpadd_u8(sum, sum);
+            sum = vpadd_u8(sum, sum);
+            return vget_lane_u16(vreinterpret_u16_u8(sum), 0);
+        }
+
+        uint64_t CompareBlock(Compare compare, const uint8_t *current, const uint8_t *last, uint8_t value) {
+            uint8x16_t valueVector = vdupq_n_u8(value);
+            uint64_t mask = 0;
+            for (int i = 0; i < 4; ++i) {
+                uint8x16_t a = vld1q_u8(current + i * 16);
+                uint8x16_t b = compare == CompareValue ? valueVector : vld1q_u8(last + i * 16);
+                uint8x16_t result;
+                switch (compare) {
+                    case CompareChanged:
+                        result = vmvnq_u8(vceqq_u8(a, b));
+                        break;
+                    case CompareGreater:
+                        result = vcgtq_u8(a, b);
+                        break;
+                    case CompareLess:
+                        result = vcltq_u8(a, b);
+                        break;
+                    default:
+                        result = vceqq_u8(a, b);
+                        break;
+                }
+                mask |= MoveMask(result) << (i * 16);
+            }
+            return mask;
+        }
+#else
+        uint64_t CompareBlock(Compare compare, const uint8_t *current, const uint8_t *last, uint8_t value) {
+            return CompareScalar(compare, current, last, value, BLOCK_SIZE);
+        }
+#endif
+    }
+
+    void Start(Search &search, const uint8_t *memory, size_t size) {
+        search.memory = memory;
+        search.size = size;
+        search.snapshot.assign(memory, memory + size);
+        search.candidates.assign((size + BLOCK_SIZE - 1) / BLOCK_SIZE, ~0ull);
+        if (size % BLOCK_SIZE)
+            search.candidates.back() = (1ull << (size % BLOCK_SIZE)) - 1;
+        search.candidateCount = size;
+    }
+
+    size_t Refine(Search &search, Compare compare, uint8_t value) {
+        if (!search.memory)
+            return 0;
+
+        size_t count = 0;
+        for (size_t block = 0; block < search.candidates.size(); ++block) {
+            uint64_t &candidates = search.candidates[block];
+            // most of the memory gets ruled out after the first few steps
+            if (!candidates)
+                continue;
+
+            size_t offset = block * BLOCK_SIZE;
+            const uint8_t *current = search.memory + offset;
+            const uint8_t *last = search.snapshot.data() + offset;
+            if (offset + BLOCK_SIZE <= search.size)
+                candidates &= CompareBlock(compare, current, last, value);
+            else
+                candidates &= CompareScalar(compare, current, last, value, search.size - offset);
+
+            count += __builtin_popcountll(candidates);
+        }
+
+        memcpy(search.snapshot.data(), search.memory, search.size);
+        search.candidateCount = count;
+        return count;
+    }
+
+    void Candidates(const Search &search, std::vector<uint32_t> &addresses, size_t maxCount) {
+        addresses.clear();
+        for (size_t block = 0; block < search.candidates.size() && addresses.size() < maxCount; ++block) {
+            uint64_t candidates = search.candidates[block];
+            while (candidates && addresses.size() < maxCount) {
+                addresses.push_back((uint32_t) (block * BLOCK_SIZE + __builtin_ctzll(candidates)));
+                candidates &= candidates - 1;
+            }
+        }
+    }
+
+    const char *CompareName(Compare compare) {
+        static const char *names[COMPARE_COUNT] = {"Unchanged", "Changed", "Greater", "Less", "Value"};
+        return names[compare];
+    }
+
+}  // namespace MemorySearch
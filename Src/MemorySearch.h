@@ -0,0 +1,45 @@
+#ifndef VB_MEMORY_SEARCH_H
+#define VB_MEMORY_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte wise search over emulated memory. Every refinement compares the memory against the
+// snapshot taken by the previous step and clears the candidates that do not match; candidates
+// are kept as one bit per byte so a full scan is a handful of vector compares per 64 bytes.
+namespace MemorySearch {
+
+    enum Compare {
+        // value did not change since the last step
+        CompareEqual,
+        CompareChanged,
+        CompareGreater,
+        CompareLess,
+        // value equals the one passed to Refine
+        CompareValue,
+        COMPARE_COUNT
+    };
+
+    struct Search {
+        const uint8_t *memory = nullptr;
+        size_t size = 0;
+        std::vector<uint8_t> snapshot;
+        std::vector<uint64_t> candidates;
+        size_t candidateCount = 0;
+    };
+
+    // every byte is a candidate, snapshots the current memory
+    void Start(Search &search, const uint8_t *memory, size_t size);
+
+    // returns the number of remaining candidates
+    size_t Refine(Search &search, Compare compare, uint8_t value = 0);
+
+    // writes up to maxCount candidate addresses into addresses
+    void Candidates(const Search &search, std::vector<uint32_t> &addresses, size_t maxCount);
+
+    const char *CompareName(Compare compare);
+
+}  // namespace MemorySearch
+
+#endif
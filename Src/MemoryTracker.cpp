@@ -0,0 +1,90 @@
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cstdio>
+
+namespace MemoryTracker {
+
+    namespace {
+        std::atomic<int64_t> liveBytes[TAG_COUNT];
+        std::atomic<int64_t> peakBytes[TAG_COUNT];
+        std::atomic<uint32_t> allocationCount[TAG_COUNT];
+        std::atomic<uint32_t> freeCount[TAG_COUNT];
+
+        int64_t markBytes[TAG_COUNT];
+        uint32_t markAllocations[TAG_COUNT];
+        uint32_t markFrees[TAG_COUNT];
+    }
+
+    void Allocated(Tag tag, size_t bytes) {
+        if (bytes == 0)
+            return;
+
+        int64_t live = liveBytes[tag].fetch_add((int64_t) bytes) + (int64_t) bytes;
+        allocationCount[tag]++;
+
+        int64_t peak = peakBytes[tag].load();
+        while (live > peak && !peakBytes[tag].compare_exchange_weak(peak, live)) {}
+    }
+
+    void Freed(Tag tag, size_t bytes) {
+        if (bytes == 0)
+            return;
+
+        liveBytes[tag].fetch_sub((int64_t) bytes);
+        freeCount[tag]++;
+    }
+
+    TagStats GetStats(Tag tag) {
+        return {liveBytes[tag].load(), peakBytes[tag].load(), allocationCount[tag].load(), freeCount[tag].load()};
+    }
+
+    const char *TagName(Tag tag) {
+        static const char *names[TAG_COUNT] = {"video", "states", "library", "audio", "menu", "gpu"};
+        return names[tag];
+    }
+
+    void Mark() {
+        for (int i = 0; i < TAG_COUNT; ++i) {
+            markBytes[i] = liveBytes[i].load();
+            markAllocations[i] = allocationCount[i].load();
+            markFrees[i] = freeCount[i].load();
+        }
+    }
+
+    std::string Report(bool sinceMark) {
+        std::string report;
+        char line[160];
+        for (int i = 0; i < TAG_COUNT; ++i) {
+            TagStats stats = GetStats((Tag) i);
+            snprintf(line, sizeof(line), "%-8s %8lld kb (peak %lld kb) %u allocs %u frees", TagName((Tag) i),
+                     (long long) (stats.bytes / 1024), (long long) (stats.peakBytes / 1024), stats.allocations, stats.frees);
+            report += line;
+
+            // allocations that were not given back since the mark
+            if (sinceMark) {
+                int64_t growth = stats.bytes - markBytes[i];
+                int32_t openAllocations = (int32_t) (stats.allocations - markAllocations[i]) - (int32_t) (stats.frees - markFrees[i]);
+                if (growth > 0 || openAllocations > 0) {
+                    snprintf(line, sizeof(line), ", grew %lld bytes in %i allocs", (long long) growth, openAllocations);
+                    report += line;
+                }
+            }
+            report += "\n";
+        }
+        return report;
+    }
+
+    std::string Summary() {
+        int64_t total = 0;
+        for (int i = 0; i < TAG_COUNT; ++i)
+            if (i != TagGpu)
+                total += liveBytes[i].load();
+
+        char summary[64];
+        snprintf(summary, sizeof(summary), "Memory: %.1f MB, GPU: %.1f MB", total / (1024.0 * 1024.0),
+                 liveBytes[TagGpu].load() / (1024.0 * 1024.0));
+        return summary;
+    }
+
+}  // namespace MemoryTracker
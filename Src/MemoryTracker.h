@@ -0,0 +1,50 @@
+#ifndef VB_MEMORY_TRACKER_H
+#define VB_MEMORY_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Byte counters for the long lived frontend allocations, grouped by the subsystem that owns them.
+// Only the buffers that scale with the game or the library are reported, not every small object.
+namespace MemoryTracker {
+
+    enum Tag {
+        TagVideo,
+        TagStates,
+        TagLibrary,
+        TagAudio,
+        TagMenu,
+        // textures and swap chains, estimated from their size and format
+        TagGpu,
+        TAG_COUNT
+    };
+
+    struct TagStats {
+        int64_t bytes;
+        int64_t peakBytes;
+        uint32_t allocations;
+        uint32_t frees;
+    };
+
+    // can be called from any thread
+    void Allocated(Tag tag, size_t bytes);
+
+    void Freed(Tag tag, size_t bytes);
+
+    TagStats GetStats(Tag tag);
+
+    const char *TagName(Tag tag);
+
+    // remembers the current counters, Report shows the growth since then
+    void Mark();
+
+    // one line per tag with the live bytes, the growth since the last mark is shown as a possible leak
+    std::string Report(bool sinceMark);
+
+    // short summary for the hud
+    std::string Summary();
+
+}  // namespace MemoryTracker
+
+#endif
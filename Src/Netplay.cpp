@@ -0,0 +1,449 @@
+#include "Netplay.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Netplay {
+
+    const uint32_t PACKET_MAGIC = 0x504E4256;  // "VBNP"
+    const uint32_t HELLO_MAGIC = 0x484E4256;   // "VBNH"
+    const uint32_t STATE_MAGIC = 0x534E4256;   // "VBNS"
+    const uint32_t DONE_MAGIC = 0x444E4256;    // "VBND"
+
+    struct InputPacket {
+        uint32_t magic;
+        // frame of the first input
+        uint32_t frame;
+        uint32_t count;
+        uint32_t inputs[REDUNDANT_INPUTS];
+    };
+
+    struct HelloPacket {
+        uint32_t magic;
+        uint32_t gameHash;
+        uint32_t stateSize;
+        uint32_t nonce;
+        // the nonce of the remote player once its hello arrived, 0 before
+        uint32_t remoteNonce;
+    };
+
+    struct StatePacket {
+        uint32_t magic;
+        uint32_t stateSize;
+        uint32_t checksum;
+        uint32_t offset;
+        uint32_t size;
+        uint8_t data[STATE_CHUNK_SIZE];
+    };
+
+    struct DonePacket {
+        uint32_t magic;
+        uint32_t checksum;
+    };
+
+    const size_t STATE_PACKET_HEADER_SIZE = sizeof(StatePacket) - STATE_CHUNK_SIZE;
+
+    // fnv-1a, only used to check that the state arrived completely
+    uint32_t Checksum(const uint8_t *data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ data[i]) * 16777619u;
+        return hash;
+    }
+
+    double GetTime() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    UdpTransport::UdpTransport(int localPort, const char *remoteHost, int remotePort) {
+        socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socketFd < 0)
+            return;
+        fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL, 0) | O_NONBLOCK);
+
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons((uint16_t) localPort);
+
+        sockaddr_in remote;
+        memset(&remote, 0, sizeof(remote));
+        remote.sin_family = AF_INET;
+        remote.sin_port = htons((uint16_t) remotePort);
+
+        if (bind(socketFd, (sockaddr *) &local, sizeof(local)) != 0 ||
+            inet_pton(AF_INET, remoteHost, &remote.sin_addr) != 1) {
+            close(socketFd);
+            socketFd = -1;
+            return;
+        }
+
+        static_assert(sizeof(remoteAddress) == sizeof(sockaddr_in), "address does not fit");
+        memcpy(remoteAddress, &remote, sizeof(sockaddr_in));
+    }
+
+    UdpTransport::~UdpTransport() {
+        if (socketFd >= 0)
+            close(socketFd);
+    }
+
+    void UdpTransport::Send(const uint8_t *data, size_t size) {
+        if (socketFd >= 0)
+            sendto(socketFd, data, size, 0, (const sockaddr *) remoteAddress, sizeof(sockaddr_in));
+    }
+
+    size_t UdpTransport::Receive(uint8_t *data, size_t maxSize) {
+        if (socketFd < 0)
+            return 0;
+        ssize_t size = recvfrom(socketFd, data, maxSize, 0, nullptr, nullptr);
+        return size > 0 ? (size_t) size : 0;
+    }
+
+    void PipeTransport::CreatePair(std::unique_ptr<PipeTransport> &first, std::unique_ptr<PipeTransport> &second,
+                                   double latency, double jitter) {
+        std::shared_ptr<Queue> firstToSecond = std::make_shared<Queue>();
+        std::shared_ptr<Queue> secondToFirst = std::make_shared<Queue>();
+
+        first.reset(new PipeTransport());
+        first->sendQueue = firstToSecond;
+        first->receiveQueue = secondToFirst;
+        second.reset(new PipeTransport());
+        second->sendQueue = secondToFirst;
+        second->receiveQueue = firstToSecond;
+
+        first->latency = second->latency = latency;
+        first->jitter = second->jitter = jitter;
+        first->random.seed(1);
+        second->random.seed(2);
+    }
+
+    void PipeTransport::Send(const uint8_t *data, size_t size) {
+        std::uniform_real_distribution<double> distribution(0, jitter);
+
+        Packet packet;
+        packet.deliveryTime = GetTime() + latency + distribution(random);
+        packet.data.assign(data, data + size);
+
+        std::lock_guard<std::mutex> lock(sendQueue->mutex);
+        sendQueue->packets.push_back(packet);
+    }
+
+    size_t PipeTransport::Receive(uint8_t *data, size_t maxSize) {
+        std::lock_guard<std::mutex> lock(receiveQueue->mutex);
+
+        // jitter can reorder packets, same as on a real network
+        double time = GetTime();
+        for (std::deque<Packet>::iterator it = receiveQueue->packets.begin(); it != receiveQueue->packets.end(); ++it) {
+            if (it->deliveryTime > time)
+                continue;
+
+            size_t size = it->data.size() < maxSize ? it->data.size() : maxSize;
+            memcpy(data, it->data.data(), size);
+            receiveQueue->packets.erase(it);
+            return size;
+        }
+        return 0;
+    }
+
+    Session::Session(Transport *transport, const Core &core, uint32_t gameHash)
+            : transport(transport), core(core), gameHash(gameHash) {
+        stateSize = core.stateSize();
+        // all snapshots are allocated up front so rolling back never allocates
+        snapshots.resize(stateSize * ROLLBACK_FRAMES);
+        memset(inputs, 0, sizeof(inputs));
+        memset(&stats, 0, sizeof(stats));
+
+        currentFrame = 0;
+        confirmedFrame = 0;
+        lastRemoteInput = 0;
+        rollbackFrame = 0;
+        needsRollback = false;
+
+        syncState = SyncHandshake;
+        std::random_device random;
+        localNonce = random() | 1;
+        remoteNonce = 0;
+        isHost = false;
+        syncChecksum = 0;
+        receivedChunkCount = 0;
+        nextChunk = 0;
+        remoteRunning = false;
+    }
+
+    void Session::ReceivePackets() {
+        uint8_t data[sizeof(StatePacket)];
+        size_t size;
+        while ((size = transport->Receive(data, sizeof(data))) > 0) {
+            if (size < sizeof(uint32_t))
+                continue;
+
+            uint32_t magic;
+            memcpy(&magic, data, sizeof(uint32_t));
+            if (magic == PACKET_MAGIC)
+                ReceiveInputs(data, size);
+            else if (magic == HELLO_MAGIC)
+                ReceiveHello(data, size);
+            else if (magic == STATE_MAGIC)
+                ReceiveState(data, size);
+            else if (magic == DONE_MAGIC && size >= sizeof(DonePacket) && syncState == SyncSendingState) {
+                DonePacket packet;
+                memcpy(&packet, data, sizeof(DonePacket));
+                if (packet.checksum == syncChecksum) {
+                    syncState = SyncRunning;
+                    syncBuffer = std::vector<uint8_t>();
+                }
+            }
+        }
+    }
+
+    void Session::ReceiveHello(const uint8_t *data, size_t size) {
+        if (size < sizeof(HelloPacket) || syncState == SyncMismatch)
+            return;
+
+        HelloPacket packet;
+        memcpy(&packet, data, sizeof(HelloPacket));
+        if (packet.gameHash != gameHash || packet.stateSize != stateSize) {
+            syncState = SyncMismatch;
+            return;
+        }
+        // both picked the same nonce, the next hello decides
+        if (packet.nonce == localNonce) {
+            std::random_device random;
+            localNonce = random() | 1;
+            return;
+        }
+
+        remoteNonce = packet.nonce;
+        isHost = localNonce > remoteNonce;
+
+        // the host starts sending once it knows that its hello arrived; its state gets taken
+        // before the first frame and nothing runs until the guest confirmed it
+        if (isHost && syncState == SyncHandshake && packet.remoteNonce == localNonce) {
+            syncBuffer.resize(stateSize);
+            core.save(syncBuffer.data(), stateSize);
+            syncChecksum = Checksum(syncBuffer.data(), stateSize);
+            nextChunk = 0;
+            syncState = SyncSendingState;
+        }
+    }
+
+    void Session::ReceiveState(const uint8_t *data, size_t size) {
+        if (size < STATE_PACKET_HEADER_SIZE || remoteNonce == 0 || isHost)
+            return;
+        if (syncState != SyncHandshake && syncState != SyncReceivingState)
+            return;
+
+        StatePacket packet;
+        memcpy(&packet, data, size < sizeof(StatePacket) ? size : sizeof(StatePacket));
+        if (packet.stateSize != stateSize || packet.size > STATE_CHUNK_SIZE || size < STATE_PACKET_HEADER_SIZE + packet.size ||
+            packet.offset % STATE_CHUNK_SIZE != 0 || packet.offset + packet.size > stateSize)
+            return;
+
+        if (syncState == SyncHandshake || packet.checksum != syncChecksum) {
+            syncBuffer.resize(stateSize);
+            receivedChunks.assign((stateSize + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE, false);
+            receivedChunkCount = 0;
+            syncChecksum = packet.checksum;
+            syncState = SyncReceivingState;
+        }
+
+        uint32_t chunk = packet.offset / STATE_CHUNK_SIZE;
+        if (receivedChunks[chunk])
+            return;
+        memcpy(&syncBuffer[packet.offset], packet.data, packet.size);
+        receivedChunks[chunk] = true;
+        receivedChunkCount++;
+
+        if (receivedChunkCount == receivedChunks.size()) {
+            if (Checksum(syncBuffer.data(), stateSize) != syncChecksum) {
+                // a chunk from an older state got mixed in, start over
+                receivedChunks.assign(receivedChunks.size(), false);
+                receivedChunkCount = 0;
+                return;
+            }
+            core.load(syncBuffer.data(), stateSize);
+            syncBuffer = std::vector<uint8_t>();
+            syncState = SyncRunning;
+        }
+    }
+
+    void Session::SendHello() {
+        HelloPacket packet;
+        packet.magic = HELLO_MAGIC;
+        packet.gameHash = gameHash;
+        packet.stateSize = (uint32_t) stateSize;
+        packet.nonce = localNonce;
+        packet.remoteNonce = remoteNonce;
+        transport->Send((const uint8_t *) &packet, sizeof(HelloPacket));
+    }
+
+    void Session::SendStateChunks() {
+        uint32_t chunkCount = (uint32_t) ((stateSize + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE);
+
+        StatePacket packet;
+        packet.magic = STATE_MAGIC;
+        packet.stateSize = (uint32_t) stateSize;
+        packet.checksum = syncChecksum;
+        // the chunks get sent round robin until the guest confirms the state, lost chunks come again in the next round
+        for (uint32_t i = 0; i < STATE_CHUNKS_PER_FRAME && i < chunkCount; ++i) {
+            packet.offset = nextChunk * STATE_CHUNK_SIZE;
+            packet.size = (uint32_t) std::min<size_t>(STATE_CHUNK_SIZE, stateSize - packet.offset);
+            memcpy(packet.data, &syncBuffer[packet.offset], packet.size);
+            transport->Send((const uint8_t *) &packet, STATE_PACKET_HEADER_SIZE + packet.size);
+            nextChunk = (nextChunk + 1) % chunkCount;
+        }
+    }
+
+    void Session::SendStateDone() {
+        DonePacket packet;
+        packet.magic = DONE_MAGIC;
+        packet.checksum = syncChecksum;
+        transport->Send((const uint8_t *) &packet, sizeof(DonePacket));
+    }
+
+    void Session::Synchronize() {
+        switch (syncState) {
+            case SyncHandshake:
+            case SyncMismatch:
+                // the other player has to find out about the mismatch as well
+                SendHello();
+                break;
+            case SyncSendingState:
+                SendHello();
+                SendStateChunks();
+                break;
+            case SyncReceivingState:
+            case SyncRunning:
+                break;
+        }
+    }
+
+    void Session::ReceiveInputs(const uint8_t *data, size_t size) {
+        InputPacket packet;
+        memcpy(&packet, data, size < sizeof(InputPacket) ? size : sizeof(InputPacket));
+        if (size < sizeof(uint32_t) * 3 || packet.count > REDUNDANT_INPUTS || size < sizeof(uint32_t) * (3 + packet.count))
+            return;
+        remoteRunning = true;
+
+        for (uint32_t i = 0; i < packet.count; ++i) {
+            uint32_t frame = packet.frame + i;
+            // only the next unconfirmed frame can be taken, older ones are already known
+            if (frame != confirmedFrame)
+                continue;
+            // the remote player can not be further ahead than the rollback window
+            if (frame >= currentFrame + ROLLBACK_FRAMES)
+                break;
+
+            FrameInputs &frameInputs = Inputs(frame);
+            if (frame < currentFrame && frameInputs.remote != packet.inputs[i] && !needsRollback) {
+                needsRollback = true;
+                rollbackFrame = frame;
+            }
+
+            frameInputs.remote = packet.inputs[i];
+            frameInputs.confirmed = true;
+            lastRemoteInput = packet.inputs[i];
+            confirmedFrame++;
+        }
+    }
+
+    void Session::SendInputs(uint32_t endFrame) {
+        InputPacket packet;
+        packet.magic = PACKET_MAGIC;
+        packet.count = endFrame < REDUNDANT_INPUTS ? endFrame : REDUNDANT_INPUTS;
+        packet.frame = endFrame - packet.count;
+        for (uint32_t i = 0; i < packet.count; ++i)
+            packet.inputs[i] = Inputs(packet.frame + i).local;
+
+        transport->Send((const uint8_t *) &packet, sizeof(InputPacket));
+    }
+
+    void Session::Rollback() {
+        double startTime = GetTime();
+
+        core.load(Snapshot(rollbackFrame), stateSize);
+        for (uint32_t frame = rollbackFrame; frame < currentFrame; ++frame) {
+            FrameInputs &frameInputs = Inputs(frame);
+            // frames after the confirmed ones get predicted again with the newest input
+            if (!frameInputs.confirmed)
+                frameInputs.remote = lastRemoteInput;
+
+            if (frame != rollbackFrame)
+                core.save(Snapshot(frame), stateSize);
+            core.run(frameInputs.local, frameInputs.remote, false);
+        }
+
+        uint32_t depth = currentFrame - rollbackFrame;
+        double resimulationTime = GetTime() - startTime;
+        stats.rollbacks++;
+        stats.lastRollbackDepth = depth;
+        stats.lastResimulationTime = resimulationTime;
+        if (depth > stats.maxRollbackDepth)
+            stats.maxRollbackDepth = depth;
+        if (resimulationTime > stats.maxResimulationTime)
+            stats.maxResimulationTime = resimulationTime;
+
+        needsRollback = false;
+    }
+
+    void Session::Poll() {
+        ReceivePackets();
+        if (syncState != SyncRunning) {
+            Synchronize();
+            return;
+        }
+
+        if (!isHost && !remoteRunning)
+            SendStateDone();
+        if (needsRollback)
+            Rollback();
+        SendInputs(currentFrame);
+    }
+
+    bool Session::RunFrame(uint32_t localInput) {
+        ReceivePackets();
+
+        if (syncState != SyncRunning) {
+            Synchronize();
+            if (syncState != SyncRunning)
+                return false;
+        }
+        // the done packet can get lost, the host only starts once it got it
+        if (!isHost && !remoteRunning)
+            SendStateDone();
+
+        if (needsRollback)
+            Rollback();
+
+        // the snapshot of the oldest unconfirmed frame must not get overwritten
+        if (currentFrame >= confirmedFrame + ROLLBACK_FRAMES - 1) {
+            stats.stalls++;
+            // the input of the current frame is not known yet, only the ones before it get sent again
+            SendInputs(currentFrame);
+            return false;
+        }
+
+        FrameInputs &frameInputs = Inputs(currentFrame);
+        frameInputs.local = localInput;
+        frameInputs.confirmed = currentFrame < confirmedFrame;
+        if (!frameInputs.confirmed)
+            frameInputs.remote = lastRemoteInput;
+
+        SendInputs(currentFrame + 1);
+
+        core.save(Snapshot(currentFrame), stateSize);
+        core.run(frameInputs.local, frameInputs.remote, true);
+        currentFrame++;
+
+        return true;
+    }
+
+}  // namespace Netplay
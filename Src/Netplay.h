@@ -0,0 +1,203 @@
+#ifndef VB_NETPLAY_H
+#define VB_NETPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Rollback netplay for two players. Every frame runs right away with a predicted input
+// for the remote player; when the real input arrives and differs from the prediction the
+// session loads the snapshot of that frame and runs the frames since then again.
+//
+// Before the first frame both players exchange the hash of their game (rom, patch and core)
+// and refuse to play if they differ. The player with the higher random nonce becomes the host
+// and sends its whole state, including the save ram, so both start from the same state.
+namespace Netplay {
+
+    // frames that can be rolled back; 100ms rtt is ~3 frames of latency each way
+    const uint32_t ROLLBACK_FRAMES = 16;
+    // inputs sent with every packet so single lost packets do not matter
+    const uint32_t REDUNDANT_INPUTS = 8;
+    // the state of the host gets sent in chunks that fit into a single udp packet
+    const uint32_t STATE_CHUNK_SIZE = 1024;
+    const uint32_t STATE_CHUNKS_PER_FRAME = 32;
+
+    enum SyncState {
+        SyncHandshake,
+        SyncSendingState,
+        SyncReceivingState,
+        SyncRunning,
+        // the other player runs another game, the session never starts
+        SyncMismatch
+    };
+
+    class Transport {
+    public:
+        virtual ~Transport() {}
+
+        virtual void Send(const uint8_t *data, size_t size) = 0;
+
+        // returns the size of the received packet, 0 if there is none
+        virtual size_t Receive(uint8_t *data, size_t maxSize) = 0;
+    };
+
+    class UdpTransport : public Transport {
+    public:
+        // binds to localPort and sends to remoteHost:remotePort
+        UdpTransport(int localPort, const char *remoteHost, int remotePort);
+
+        ~UdpTransport();
+
+        bool IsOpen() const { return socketFd >= 0; }
+
+        void Send(const uint8_t *data, size_t size) override;
+
+        size_t Receive(uint8_t *data, size_t maxSize) override;
+
+    private:
+        int socketFd;
+        uint8_t remoteAddress[16];
+    };
+
+    // in process transport with artificial latency and jitter
+    class PipeTransport : public Transport {
+    public:
+        // creates two connected ends
+        static void CreatePair(std::unique_ptr<PipeTransport> &first, std::unique_ptr<PipeTransport> &second,
+                               double latency, double jitter);
+
+        void Send(const uint8_t *data, size_t size) override;
+
+        size_t Receive(uint8_t *data, size_t maxSize) override;
+
+    private:
+        struct Packet {
+            double deliveryTime;
+            std::vector<uint8_t> data;
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Packet> packets;
+        };
+
+        std::shared_ptr<Queue> sendQueue;
+        std::shared_ptr<Queue> receiveQueue;
+        double latency;
+        double jitter;
+        std::mt19937 random;
+    };
+
+    struct Core {
+        size_t (*stateSize)();
+
+        bool (*save)(void *data, size_t size);
+
+        bool (*load)(const void *data, size_t size);
+
+        // runs one frame, present is false while frames get resimulated
+        void (*run)(uint32_t localInput, uint32_t remoteInput, bool present);
+    };
+
+    struct Stats {
+        uint32_t rollbacks;
+        uint32_t lastRollbackDepth;
+        uint32_t maxRollbackDepth;
+        double lastResimulationTime;
+        double maxResimulationTime;
+        // frames that could not run because the remote player is too far behind
+        uint32_t stalls;
+    };
+
+    class Session {
+    public:
+        // gameHash has to be the same for both players
+        Session(Transport *transport, const Core &core, uint32_t gameHash);
+
+        // runs the next frame with the local input; returns false if the session had to wait for the remote player
+        // or the players are not synchronized yet
+        bool RunFrame(uint32_t localInput);
+
+        // receives and rolls back without running a new frame, used to wait for the remote inputs at the end
+        void Poll();
+
+        SyncState State() const { return syncState; }
+
+        bool IsHost() const { return isHost; }
+
+        uint32_t Frame() const { return currentFrame; }
+
+        // all remote inputs before this frame are known
+        uint32_t ConfirmedFrame() const { return confirmedFrame; }
+
+        Stats stats;
+
+    private:
+        struct FrameInputs {
+            uint32_t local;
+            uint32_t remote;
+            bool confirmed;
+        };
+
+        void ReceivePackets();
+
+        void ReceiveHello(const uint8_t *data, size_t size);
+
+        void ReceiveState(const uint8_t *data, size_t size);
+
+        void ReceiveInputs(const uint8_t *data, size_t size);
+
+        void Synchronize();
+
+        void SendHello();
+
+        void SendStateChunks();
+
+        void SendStateDone();
+
+        // sends the local inputs of the frames before endFrame
+        void SendInputs(uint32_t endFrame);
+
+        void Rollback();
+
+        FrameInputs &Inputs(uint32_t frame) { return inputs[frame % ROLLBACK_FRAMES]; }
+
+        uint8_t *Snapshot(uint32_t frame) { return &snapshots[(frame % ROLLBACK_FRAMES) * stateSize]; }
+
+        Transport *transport;
+        Core core;
+        size_t stateSize;
+
+        SyncState syncState;
+        uint32_t gameHash;
+        uint32_t localNonce;
+        // 0 until the first hello of the remote player arrived
+        uint32_t remoteNonce;
+        bool isHost;
+        // the state of the host while it gets transferred
+        std::vector<uint8_t> syncBuffer;
+        uint32_t syncChecksum;
+        std::vector<bool> receivedChunks;
+        uint32_t receivedChunkCount;
+        uint32_t nextChunk;
+        // the guest confirms the state until the first input of the host arrives
+        bool remoteRunning;
+
+        std::vector<uint8_t> snapshots;
+        FrameInputs inputs[ROLLBACK_FRAMES];
+
+        uint32_t currentFrame;
+        uint32_t confirmedFrame;
+        uint32_t lastRemoteInput;
+        // oldest frame that was simulated with a wrong prediction
+        uint32_t rollbackFrame;
+        bool needsRollback;
+    };
+
+}  // namespace Netplay
+
+#endif
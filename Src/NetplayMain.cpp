@@ -0,0 +1,272 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+#include <vrvb.h>
+
+#include "EmulatorContext.h"
+#include "Netplay.h"
+
+// vbnetplay <rom> [frames] [latency ms] [jitter ms] [loss %]
+// runs two players in their own processes over udp on the loopback with the given latency, jitter
+// and packet loss. Each player starts from a different local state and save ram and plays its own
+// inputs; after the last frame got confirmed both have to end up with the same state. A second run
+// gives one player another game hash and checks that both refuse to play.
+
+namespace {
+
+    const double FRAME_TIME = 1 / 50.27;
+    const double SYNC_TIMEOUT = 10;
+
+    struct PlayerResult {
+        bool synced;
+        bool mismatch;
+        bool host;
+        uint32_t stateCrc;
+        uint32_t frames;
+        Netplay::Stats stats;
+    };
+
+    // holds the packets back for latency + jitter and drops some of them
+    class DelayedTransport : public Netplay::Transport {
+    public:
+        DelayedTransport(Netplay::Transport *transport, double latency, double jitter, double loss, uint32_t seed)
+                : transport(transport), latency(latency), jitter(jitter), loss(loss), random(seed) {}
+
+        void Send(const uint8_t *data, size_t size) override {
+            std::uniform_real_distribution<double> distribution(0, 1);
+            if (distribution(random) < loss)
+                return;
+
+            Packet packet;
+            packet.sendTime = Time() + latency + distribution(random) * jitter;
+            packet.data.assign(data, data + size);
+            // jitter reorders packets, same as on a real network
+            std::deque<Packet>::iterator it = queue.end();
+            while (it != queue.begin() && (it - 1)->sendTime > packet.sendTime)
+                --it;
+            queue.insert(it, packet);
+            Flush();
+        }
+
+        size_t Receive(uint8_t *data, size_t maxSize) override {
+            Flush();
+            return transport->Receive(data, maxSize);
+        }
+
+    private:
+        struct Packet {
+            double sendTime;
+            std::vector<uint8_t> data;
+        };
+
+        static double Time() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void Flush() {
+            double time = Time();
+            while (!queue.empty() && queue.front().sendTime <= time) {
+                transport->Send(queue.front().data.data(), queue.front().data.size());
+                queue.pop_front();
+            }
+        }
+
+        Netplay::Transport *transport;
+        double latency, jitter, loss;
+        std::mt19937 random;
+        std::deque<Packet> queue;
+    };
+
+    void HeadlessVideo(Emulator::Context &context, const void *data, unsigned width, unsigned height) {
+        context.currentScreenData = data;
+    }
+
+    // a few buttons that change every couple of frames, different for both players
+    uint32_t PlayerInput(int player, uint32_t frame) {
+        uint32_t hash = (frame / 6 + 1) * 2654435761u ^ (player + 1) * 40503u;
+        hash ^= hash >> 15;
+        return hash & (player == 0 ? 0x00F3 : 0x3F00);
+    }
+
+    size_t StateSize() { return VRVB::retro_serialize_size(); }
+
+    bool SaveState(void *data, size_t size) { return VRVB::retro_serialize(data, size); }
+
+    bool LoadState(const void *data, size_t size) { return VRVB::retro_unserialize(data, size); }
+
+    void RunCore(uint32_t localInput, uint32_t remoteInput, bool present) {
+        VRVB::input_buf[0] = localInput | remoteInput;
+        VRVB::Run();
+    }
+
+    double Seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    PlayerResult RunPlayer(int player, const std::vector<uint8_t> &rom, int localPort, int remotePort, uint32_t frames,
+                           double latency, double jitter, double loss, bool wrongGame) {
+        PlayerResult result = {};
+
+        Emulator::Context context;
+        context.videoCallback = HeadlessVideo;
+        Emulator::SetActiveContext(&context);
+        VRVB::LoadRom(rom.data(), rom.size());
+        uint32_t romHash = (uint32_t) crc32(0, rom.data(), (uInt) rom.size());
+
+        // both players get a different state and save ram, the session has to replace the one of the guest
+        for (int i = 0; i < 60 + player * 90; ++i) {
+            VRVB::input_buf[0] = PlayerInput(player, (uint32_t) i * 7);
+            VRVB::Run();
+        }
+        if (VRVB::save_ram_size() > 0)
+            memset(VRVB::save_ram(), 0x11 * (player + 1), VRVB::save_ram_size());
+
+        Netplay::UdpTransport udp(localPort, "127.0.0.1", remotePort);
+        if (!udp.IsOpen())
+            return result;
+        DelayedTransport transport(&udp, latency, jitter, loss, (uint32_t) player + 1);
+
+        Netplay::Core core;
+        core.stateSize = StateSize;
+        core.save = SaveState;
+        core.load = LoadState;
+        core.run = RunCore;
+        Netplay::Session session(&transport, core, romHash + (wrongGame ? 1 : 0));
+
+        auto startTime = std::chrono::steady_clock::now();
+        auto frameTime = startTime;
+        while (session.Frame() < frames) {
+            if (session.State() == Netplay::SyncMismatch && Seconds(startTime) > 1) {
+                result.mismatch = true;
+                return result;
+            }
+            if (session.State() != Netplay::SyncRunning && Seconds(startTime) > SYNC_TIMEOUT)
+                return result;
+
+            session.RunFrame(PlayerInput(player, session.Frame()));
+            frameTime += std::chrono::microseconds((long long) (FRAME_TIME * 1000000));
+            std::this_thread::sleep_until(frameTime);
+        }
+
+        // the last frames were run with predicted inputs, the state only counts once they are confirmed
+        auto endTime = std::chrono::steady_clock::now();
+        while (session.ConfirmedFrame() < frames && Seconds(endTime) < SYNC_TIMEOUT) {
+            session.Poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        std::vector<uint8_t> state(VRVB::retro_serialize_size());
+        VRVB::retro_serialize(state.data(), state.size());
+        result.synced = session.ConfirmedFrame() >= frames;
+        result.host = session.IsHost();
+        result.stateCrc = (uint32_t) crc32(0, state.data(), (uInt) state.size());
+        result.frames = session.Frame();
+        result.stats = session.stats;
+
+        // the other player can still be waiting for inputs that got lost
+        auto lingerTime = std::chrono::steady_clock::now();
+        while (Seconds(lingerTime) < 1) {
+            session.Poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return result;
+    }
+
+    bool RunPair(const std::vector<uint8_t> &rom, uint32_t frames, double latency, double jitter, double loss, bool wrongGame,
+                 PlayerResult results[2]) {
+        int basePort = 40000 + (getpid() % 10000) * 2;
+
+        pid_t pids[2];
+        int pipes[2];
+        for (int player = 0; player < 2; ++player) {
+            int fds[2];
+            if (pipe(fds) != 0)
+                return false;
+
+            pids[player] = fork();
+            if (pids[player] == 0) {
+                close(fds[0]);
+                PlayerResult result = RunPlayer(player, rom, basePort + player, basePort + 1 - player, frames, latency, jitter,
+                                                loss, wrongGame && player == 1);
+                ssize_t written = write(fds[1], &result, sizeof(PlayerResult));
+                _exit(written == sizeof(PlayerResult) ? 0 : 1);
+            }
+            close(fds[1]);
+            pipes[player] = fds[0];
+        }
+
+        bool complete = true;
+        for (int player = 0; player < 2; ++player) {
+            results[player] = PlayerResult();
+            complete &= read(pipes[player], &results[player], sizeof(PlayerResult)) == sizeof(PlayerResult);
+            close(pipes[player]);
+            waitpid(pids[player], nullptr, 0);
+        }
+        return complete;
+    }
+
+    void PrintResult(int player, const PlayerResult &result) {
+        printf("player %i: %s, %u frames, state %08x, %u rollbacks (max depth %u, max %.2fms), %u stalls\n", player,
+               result.synced ? (result.host ? "host" : "guest") : result.mismatch ? "refused" : "not synchronized",
+               result.frames, result.stateCrc, result.stats.rollbacks, result.stats.maxRollbackDepth,
+               result.stats.maxResimulationTime * 1000, result.stats.stalls);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <rom> [frames] [latency ms] [jitter ms] [loss %%]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream file(argv[1], std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        fprintf(stderr, "could not open %s\n", argv[1]);
+        return 2;
+    }
+    std::vector<uint8_t> rom((size_t) file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read((char *) rom.data(), rom.size());
+
+    uint32_t frames = argc > 2 ? (uint32_t) atoi(argv[2]) : 600;
+    double latency = (argc > 3 ? atof(argv[3]) : 50) / 1000;
+    double jitter = (argc > 4 ? atof(argv[4]) : 20) / 1000;
+    double loss = (argc > 5 ? atof(argv[5]) : 1) / 100;
+
+    // the players get forked with the initialized core
+    VRVB::Init();
+
+    printf("%u frames, %.0fms latency, %.0fms jitter, %.1f%% loss\n", frames, latency * 1000, jitter * 1000, loss * 100);
+    PlayerResult results[2];
+    if (!RunPair(rom, frames, latency, jitter, loss, false, results)) {
+        printf("a player crashed\n");
+        return 1;
+    }
+    PrintResult(0, results[0]);
+    PrintResult(1, results[1]);
+    bool matched = results[0].synced && results[1].synced && results[0].host != results[1].host &&
+                   results[0].stateCrc == results[1].stateCrc;
+    printf("%s\n", matched ? "states match" : "states differ");
+
+    printf("different game:\n");
+    if (!RunPair(rom, 50, latency, jitter, loss, true, results)) {
+        printf("a player crashed\n");
+        return 1;
+    }
+    PrintResult(0, results[0]);
+    PrintResult(1, results[1]);
+    bool refused = results[0].mismatch && results[1].mismatch;
+    printf("%s\n", refused ? "both refused" : "not refused");
+
+    return matched && refused ? 0 : 1;
+}
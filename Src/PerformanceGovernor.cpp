@@ -0,0 +1,119 @@
+#include "PerformanceGovernor.h"
+
+#include <fstream>
+
+namespace PerformanceGovernor {
+
+    void Reset(State &state, const Config &config) {
+        state.cpuLevel = config.startCpuLevel;
+        state.gpuLevel = config.startGpuLevel;
+        state.degradeLevel = DegradeNone;
+        state.windowFrames = 0;
+        state.staleFrames = 0;
+        state.costSum = 0;
+        state.temperature = 0;
+        state.calmWindows = 0;
+    }
+
+    bool EndWindow(State &state, const Config &config) {
+        float averageCost = state.costSum / state.windowFrames / config.framePeriod;
+        bool hot = state.temperature >= config.hotTemperature;
+        bool cpuBound = averageCost > config.highCost;
+        bool pressure = cpuBound || state.staleFrames > config.staleLimit;
+
+        if (pressure) {
+            state.calmWindows = 0;
+
+            // prefer higher clocks while the device is cool enough
+            if (!hot) {
+                // stale frames with a cheap frontend mean the gpu is not keeping up
+                if (cpuBound && state.cpuLevel < config.maxLevel) {
+                    state.cpuLevel++;
+                    return true;
+                }
+                if (!cpuBound && state.gpuLevel < config.maxLevel) {
+                    state.gpuLevel++;
+                    return true;
+                }
+            }
+
+            if (state.degradeLevel < DegradeLevelCount - 1) {
+                state.degradeLevel = (DegradeLevel) (state.degradeLevel + 1);
+                return true;
+            }
+            return false;
+        }
+
+        bool headroom = state.staleFrames == 0 && averageCost < config.lowCost;
+        if (!headroom && !hot) {
+            state.calmWindows = 0;
+            return false;
+        }
+
+        if (++state.calmWindows < config.recoverWindows)
+            return false;
+        state.calmWindows = 0;
+
+        // give back quality first, then lower the clocks to save power and heat
+        if (state.degradeLevel > DegradeNone && !hot) {
+            state.degradeLevel = (DegradeLevel) (state.degradeLevel - 1);
+            return true;
+        }
+        if (state.gpuLevel > config.minLevel) {
+            state.gpuLevel--;
+            return true;
+        }
+        if (state.cpuLevel > config.minLevel) {
+            state.cpuLevel--;
+            return true;
+        }
+        return false;
+    }
+
+    bool Update(State &state, const Config &config, const Sample &sample) {
+        state.windowFrames++;
+        state.costSum += sample.frameCost;
+        if (sample.deltaSeconds > config.framePeriod * 1.5f)
+            state.staleFrames++;
+        if (sample.temperature > 0)
+            state.temperature = sample.temperature;
+
+        if (state.windowFrames < config.windowSize)
+            return false;
+
+        bool changed = EndWindow(state, config);
+
+        state.windowFrames = 0;
+        state.staleFrames = 0;
+        state.costSum = 0;
+
+        return changed;
+    }
+
+    std::string DegradeName(DegradeLevel level) {
+        switch (level) {
+            case DegradeNone:
+                return "none";
+            case DegradeSkipUpscale:
+                return "skip upscale";
+            case DegradeMono:
+                return "mono";
+            case DegradeFrameskip:
+                return "frameskip";
+            default:
+                return "unknown";
+        }
+    }
+
+    float ReadTemperature(const char *path) {
+        std::ifstream file(path);
+        if (!file.is_open())
+            return 0;
+
+        // thermal zones report millidegree
+        int value = 0;
+        file >> value;
+        return value / 1000.0f;
+    }
+
+}  // namespace PerformanceGovernor
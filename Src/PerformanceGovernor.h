@@ -0,0 +1,72 @@
+#ifndef VB_PERFORMANCE_GOVERNOR_H
+#define VB_PERFORMANCE_GOVERNOR_H
+
+#include <string>
+
+// Decides the cpu/gpu clock levels and how much work the frontend may skip.
+// Everything in here only works on the samples it gets fed, so it can be driven by
+// recorded or synthetic timing traces without a headset, vbgovernor (GovernorMain.cpp) does that.
+namespace PerformanceGovernor {
+
+    // every level includes the ones before it
+    enum DegradeLevel {
+        DegradeNone = 0,
+        DegradeSkipUpscale,
+        DegradeMono,
+        DegradeFrameskip,
+        DegradeLevelCount
+    };
+
+    struct Config {
+        float framePeriod = 1 / 72.0f;
+        // frames in one decision window
+        int windowSize = 72;
+        // average frontend cost relative to the frame period
+        float highCost = 0.5f;
+        float lowCost = 0.25f;
+        // stale frames per window that count as pressure
+        int staleLimit = 3;
+        // calm windows needed before the governor gives back quality or clocks
+        int recoverWindows = 5;
+        int minLevel = 0;
+        int maxLevel = 4;
+        int startCpuLevel = 2;
+        int startGpuLevel = 2;
+        // above this the clocks do not get raised anymore, degrading is used instead
+        float hotTemperature = 42.0f;
+    };
+
+    struct Sample {
+        // seconds the frontend spent on emulation and screen updates this frame
+        float frameCost;
+        // time since the last frame
+        float deltaSeconds;
+        // degree celsius, 0 if unknown
+        float temperature;
+    };
+
+    struct State {
+        int cpuLevel;
+        int gpuLevel;
+        DegradeLevel degradeLevel;
+
+        int windowFrames;
+        int staleFrames;
+        float costSum;
+        float temperature;
+        int calmWindows;
+    };
+
+    void Reset(State &state, const Config &config);
+
+    // returns true if the clock levels or the degrade level changed
+    bool Update(State &state, const Config &config, const Sample &sample);
+
+    std::string DegradeName(DegradeLevel level);
+
+    // reads a thermal zone in degree celsius, returns 0 if it is not available
+    float ReadTemperature(const char *path);
+
+}  // namespace PerformanceGovernor
+
+#endif
@@ -0,0 +1,114 @@
+#include "Preloader.h"
+
+#include "MemoryTracker.h"
+
+Preloader::Preloader(size_t maxBytes) : maxBytes(maxBytes) {}
+
+Preloader::~Preloader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void Preloader::Drop() {
+    if (readyKey.empty())
+        return;
+
+    MemoryTracker::Freed(MemoryTracker::TagLibrary, ready.Bytes());
+    ready = Data();
+    readyKey.clear();
+    stats.discarded++;
+}
+
+void Preloader::Request(const std::string &key, LoadFunction load) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (key == readyKey || key == loadingKey || key == pendingKey)
+            return;
+
+        // the worker only gets started once something is requested
+        if (!worker.joinable())
+            worker = std::thread(&Preloader::WorkerThread, this);
+
+        Drop();
+        pendingKey = key;
+        pendingLoad = load;
+        stats.requests++;
+    }
+    condition.notify_all();
+}
+
+bool Preloader::Take(const std::string &key, Data &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (key == pendingKey) {
+        // loading it here is not faster than doing it the normal way
+        pendingKey.clear();
+        pendingLoad = nullptr;
+        return false;
+    }
+
+    if (key == loadingKey) {
+        // waiting could block the caller for as long as a download takes
+        dropLoading = true;
+        stats.notReady++;
+        return false;
+    }
+    if (key != readyKey)
+        return false;
+
+    MemoryTracker::Freed(MemoryTracker::TagLibrary, ready.Bytes());
+    data = std::move(ready);
+    ready = Data();
+    readyKey.clear();
+    return data.loaded;
+}
+
+Preloader::Stats Preloader::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void Preloader::WorkerThread() {
+    while (true) {
+        std::string key;
+        LoadFunction load;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !pendingKey.empty(); });
+            if (stopping)
+                return;
+
+            key = pendingKey;
+            load = pendingLoad;
+            pendingKey.clear();
+            pendingLoad = nullptr;
+            loadingKey = key;
+            dropLoading = false;
+        }
+
+        Data data = Data();
+        data.loaded = load(data);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loadingKey.clear();
+            stats.loads++;
+
+            if (data.Bytes() > maxBytes) {
+                stats.overBudget++;
+            } else if (!pendingKey.empty() || dropLoading) {
+                // the selection moved on or the game got started without it while this was loading
+                stats.discarded++;
+            } else {
+                ready = std::move(data);
+                readyKey = key;
+                MemoryTracker::Allocated(MemoryTracker::TagLibrary, ready.Bytes());
+            }
+        }
+        condition.notify_all();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef VB_PRELOADER_H
+#define VB_PRELOADER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads everything a game needs before it gets started. Only one game gets held at a time,
+// requesting another one throws the prepared data away.
+class Preloader {
+public:
+    static const int SLOT_COUNT = 10;
+
+    struct Data {
+        bool loaded;
+        std::string patchPath;
+        std::vector<uint8_t> rom;
+        bool hasRam;
+        std::vector<uint8_t> ram;
+        // left eye image of every slot
+        std::vector<uint8_t> slotImages;
+        uint32_t slotImageMask;
+        uint32_t slotStateMask;
+
+        size_t Bytes() const { return rom.capacity() + ram.capacity() + slotImages.capacity(); }
+    };
+
+    typedef std::function<bool(Data &data)> LoadFunction;
+
+    struct Stats {
+        uint32_t requests;
+        uint32_t loads;
+        uint32_t overBudget;
+        uint32_t discarded;
+        // takes that found the data still loading
+        uint32_t notReady;
+    };
+
+    explicit Preloader(size_t maxBytes);
+
+    ~Preloader();
+
+    // replaces the pending request, does nothing if key is already loading or loaded
+    void Request(const std::string &key, LoadFunction load);
+
+    // hands over the data for key if it is ready, never waits for a running load
+    bool Take(const std::string &key, Data &data);
+
+    Stats GetStats();
+
+private:
+    void WorkerThread();
+
+    void Drop();
+
+    const size_t maxBytes;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::thread worker;
+    bool stopping = false;
+
+    std::string pendingKey;
+    LoadFunction pendingLoad;
+    std::string loadingKey;
+    // the running load was not ready when it got taken and gets thrown away once it finishes
+    bool dropLoading = false;
+    std::string readyKey;
+    Data ready;
+
+    Stats stats = {};
+};
+
+#endif
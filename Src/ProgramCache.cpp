@@ -0,0 +1,100 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+namespace ProgramCache {
+
+    const uint32_t CACHE_MAGIC = 0x43505656;  // "VVPC"
+    const uint32_t CACHE_VERSION = 1;
+    // a program binary is a few hundred kb at most, anything bigger is a broken file
+    const uint32_t MAX_BINARY_SIZE = 4 * 1024 * 1024;
+    const uint32_t MAX_DRIVER_ID_SIZE = 1024;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sourceHash;
+        uint32_t driverIdSize;
+        uint32_t binaryFormat;
+        uint32_t binarySize;
+    };
+
+    std::string DriverId() {
+        const GLubyte *version = glGetString(GL_VERSION);
+        const GLubyte *renderer = glGetString(GL_RENDERER);
+        return std::string(version ? (const char *) version : "") + "|" + (renderer ? (const char *) renderer : "");
+    }
+
+    uint32_t HashSources(const char *vertexSource, const char *fragmentSource) {
+        uLong crc = crc32(0, (const Bytef *) vertexSource, (uInt) strlen(vertexSource));
+        return (uint32_t) crc32(crc, (const Bytef *) fragmentSource, (uInt) strlen(fragmentSource));
+    }
+
+    GLuint Load(const std::string &path, const std::string &driverId, uint32_t sourceHash) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return 0;
+
+        Header header;
+        bool valid = fread(&header, sizeof(Header), 1, file) == 1 && header.magic == CACHE_MAGIC &&
+                     header.version == CACHE_VERSION && header.sourceHash == sourceHash &&
+                     header.driverIdSize == driverId.size() && header.driverIdSize <= MAX_DRIVER_ID_SIZE &&
+                     header.binarySize > 0 && header.binarySize <= MAX_BINARY_SIZE;
+
+        // a driver update changes the version string, the old binary would not link anymore
+        std::vector<char> fileDriverId(valid ? header.driverIdSize : 0);
+        valid = valid && fread(fileDriverId.data(), 1, fileDriverId.size(), file) == fileDriverId.size() &&
+                memcmp(fileDriverId.data(), driverId.data(), driverId.size()) == 0;
+
+        std::vector<uint8_t> binary(valid ? header.binarySize : 0);
+        valid = valid && fread(binary.data(), 1, binary.size(), file) == binary.size();
+        fclose(file);
+        if (!valid)
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei) binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    bool Save(const std::string &path, const std::string &driverId, uint32_t sourceHash, GLuint program) {
+        GLint binarySize = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+        if (binarySize <= 0 || (uint32_t) binarySize > MAX_BINARY_SIZE)
+            return false;
+
+        std::vector<uint8_t> binary((size_t) binarySize);
+        GLenum binaryFormat = 0;
+        GLsizei length = 0;
+        glGetProgramBinary(program, binarySize, &length, &binaryFormat, binary.data());
+        if (length <= 0)
+            return false;
+
+        Header header = {CACHE_MAGIC, CACHE_VERSION, sourceHash, (uint32_t) driverId.size(), binaryFormat, (uint32_t) length};
+
+        // written next to the cache and renamed, a half written file would only get thrown away but costs a build
+        std::string tempPath = path + ".tmp";
+        FILE *file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+            return false;
+        bool written = fwrite(&header, sizeof(Header), 1, file) == 1 &&
+                       fwrite(driverId.data(), 1, driverId.size(), file) == driverId.size() &&
+                       fwrite(binary.data(), 1, (size_t) length, file) == (size_t) length;
+        written &= fclose(file) == 0;
+        if (!written) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+}  // namespace ProgramCache
@@ -0,0 +1,26 @@
+#ifndef VB_PROGRAM_CACHE_H
+#define VB_PROGRAM_CACHE_H
+
+#include <GLES3/gl3.h>
+#include <cstdint>
+#include <string>
+
+// Keeps the linked binary of a gl program on disk so later starts do not have to compile and link the
+// shaders again. A binary only works with the driver it came from, so the file remembers GL_VERSION and
+// GL_RENDERER together with a hash of the shader sources; a file that does not match gets ignored and
+// replaced by the next save.
+namespace ProgramCache {
+
+    // GL_VERSION and GL_RENDERER of the current context
+    std::string DriverId();
+
+    uint32_t HashSources(const char *vertexSource, const char *fragmentSource);
+
+    // returns a linked program or 0 if there is no binary for this driver and these sources or it did not link
+    GLuint Load(const std::string &path, const std::string &driverId, uint32_t sourceHash);
+
+    bool Save(const std::string &path, const std::string &driverId, uint32_t sourceHash, GLuint program);
+
+}  // namespace ProgramCache
+
+#endif
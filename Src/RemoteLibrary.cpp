@@ -0,0 +1,397 @@
+#include "RemoteLibrary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <netdb.h>
+#include <sstream>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace RemoteLibrary {
+
+    namespace {
+        const char *URL_PREFIX = "http://";
+        // small enough to keep every request short, big enough to not spend the time on requests
+        const uint32_t CHUNK_SIZE = 256 * 1024;
+        const int TIMEOUT_SECONDS = 5;
+        const int MAX_RETRIES = 3;
+        // the whole rom from a server without range support plus the header
+        const size_t MAX_RESPONSE_SIZE = MAX_ROM_SIZE + 64 * 1024;
+
+        bool SplitUrl(const std::string &url, std::string &host, std::string &port, std::string &path) {
+            if (url.compare(0, strlen(URL_PREFIX), URL_PREFIX) != 0)
+                return false;
+
+            size_t hostStart = strlen(URL_PREFIX);
+            size_t pathStart = url.find('/', hostStart);
+            std::string hostPort = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+            path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+            size_t portStart = hostPort.find(':');
+            host = hostPort.substr(0, portStart);
+            port = portStart == std::string::npos ? "80" : hostPort.substr(portStart + 1);
+            return !host.empty();
+        }
+
+        int Connect(const std::string &host, const std::string &port) {
+            addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo *addresses;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+                return -1;
+
+            int fd = -1;
+            for (addrinfo *address = addresses; address && fd < 0; address = address->ai_next) {
+                fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (fd < 0)
+                    continue;
+
+                timeval timeout = {TIMEOUT_SECONDS, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(addresses);
+            return fd;
+        }
+
+        // rom names often contain spaces
+        std::string EncodePath(const std::string &path) {
+            std::string encoded;
+            for (char c : path) {
+                if (c == ' ')
+                    encoded += "%20";
+                else
+                    encoded += c;
+            }
+            return encoded;
+        }
+
+        // value of a header field, case insensitive like http wants it
+        bool HeaderField(const std::string &header, const char *name, std::string &value) {
+            std::istringstream stream(header);
+            std::string line;
+            size_t nameLength = strlen(name);
+            while (std::getline(stream, line)) {
+                if (line.size() > nameLength && line[nameLength] == ':' && strncasecmp(line.c_str(), name, nameLength) == 0) {
+                    value = line.substr(nameLength + 1);
+                    value.erase(0, value.find_first_not_of(' '));
+                    if (!value.empty() && value.back() == '\r')
+                        value.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // the manifest paths are relative to the folder of the manifest
+        std::string ResolveUrl(const std::string &manifestUrl, const std::string &path) {
+            if (IsRemote(path))
+                return path;
+            return manifestUrl.substr(0, manifestUrl.find_last_of('/') + 1) + path;
+        }
+    }
+
+    bool IsRemote(const std::string &path) {
+        return path.compare(0, strlen(URL_PREFIX), URL_PREFIX) == 0;
+    }
+
+    bool ParseManifest(const std::string &text, const std::string &manifestUrl, std::vector<Entry> &entries) {
+        entries.clear();
+
+        std::istringstream stream(text);
+        std::string line;
+        while (std::getline(stream, line)) {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream lineStream(line);
+            Entry entry;
+            std::string path;
+            if (!(lineStream >> std::hex >> entry.crc >> std::dec >> entry.size) || !std::getline(lineStream >> std::ws, path))
+                continue;
+            if (!path.empty() && path.back() == '\r')
+                path.pop_back();
+            if (path.empty() || entry.size == 0 || entry.size > MAX_ROM_SIZE)
+                continue;
+
+            std::string fileName = path.substr(path.find_last_of('/') + 1);
+            entry.Name = fileName.substr(0, fileName.find_last_of('.'));
+            entry.Url = ResolveUrl(manifestUrl, path);
+            entries.push_back(entry);
+        }
+        return !entries.empty();
+    }
+
+    bool HttpGet(const std::string &url, uint32_t rangeStart, uint32_t rangeLength, std::vector<uint8_t> &body,
+                 uint64_t *resourceSize) {
+        body.clear();
+        if (resourceSize)
+            *resourceSize = 0;
+
+        std::string host, port, path;
+        if (!SplitUrl(url, host, port, path))
+            return false;
+
+        int fd = Connect(host, port);
+        if (fd < 0)
+            return false;
+
+        // http 1.0 so the server does not answer with a chunked body
+        std::string request = "GET " + EncodePath(path) + " HTTP/1.0\r\nHost: " + host + "\r\n";
+        if (rangeLength > 0)
+            request += "Range: bytes=" + std::to_string(rangeStart) + "-" + std::to_string(rangeStart + rangeLength - 1) + "\r\n";
+        request += "Connection: close\r\n\r\n";
+
+        if (send(fd, request.data(), request.size(), 0) != (ssize_t) request.size()) {
+            close(fd);
+            return false;
+        }
+
+        std::vector<uint8_t> response;
+        response.reserve(rangeLength + 1024);
+        uint8_t buffer[16 * 1024];
+        ssize_t received;
+        while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0 && response.size() + received <= MAX_RESPONSE_SIZE)
+            response.insert(response.end(), buffer, buffer + received);
+        close(fd);
+        if (received != 0)
+            return false;
+
+        const char *separator = "\r\n\r\n";
+        std::vector<uint8_t>::iterator headerEnd = std::search(response.begin(), response.end(), separator, separator + 4);
+        if (headerEnd == response.end())
+            return false;
+
+        std::string header(response.begin(), headerEnd);
+        int status = 0;
+        if (sscanf(header.c_str(), "HTTP/%*d.%*d %d", &status) != 1)
+            return false;
+
+        body.assign(headerEnd + 4, response.end());
+
+        // a connection that broke off looks like a complete response with http 1.0
+        std::string field;
+        if (HeaderField(header, "Content-Length", field) && strtoull(field.c_str(), nullptr, 10) != body.size())
+            return false;
+        uint64_t totalSize = status == 200 ? body.size() : 0;
+        if (status == 206 && HeaderField(header, "Content-Range", field)) {
+            size_t slash = field.find('/');
+            if (slash != std::string::npos && field.compare(slash + 1, std::string::npos, "*") != 0)
+                totalSize = strtoull(field.c_str() + slash + 1, nullptr, 10);
+        }
+        if (resourceSize)
+            *resourceSize = totalSize;
+
+        if (rangeLength == 0)
+            return status == 200;
+
+        // servers without range support send everything
+        if (status == 200 && body.size() > rangeStart) {
+            body.erase(body.begin(), body.begin() + rangeStart);
+            body.resize(std::min((size_t) rangeLength, body.size()));
+            return body.size() == rangeLength;
+        }
+        return status == 206 && body.size() == rangeLength;
+    }
+
+    Library::Library(RomCache &cache) : cache(cache) {}
+
+    Library::~Library() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool Library::UseManifest(const std::string &text) {
+        std::vector<Entry> manifestEntries;
+        if (!ParseManifest(text, manifestUrl, manifestEntries))
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.swap(manifestEntries);
+        entriesChanged = true;
+        return true;
+    }
+
+    void Library::Open(const std::string &manifestUrl, const std::string &manifestCachePath) {
+        this->manifestUrl = manifestUrl;
+        this->manifestCachePath = manifestCachePath;
+
+        std::ifstream file(manifestCachePath);
+        if (file.is_open()) {
+            std::stringstream text;
+            text << file.rdbuf();
+            UseManifest(text.str());
+        }
+
+        worker = std::thread(&Library::WorkerThread, this);
+    }
+
+    bool Library::TakeEntries(std::vector<Entry> &takenEntries) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!entriesChanged)
+            return false;
+
+        takenEntries = entries;
+        entriesChanged = false;
+        return true;
+    }
+
+    bool Library::Find(const std::string &url, Entry &entry) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Entry &current : entries) {
+            if (current.Url == url) {
+                entry = current;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Library::Prefetch(const Entry &entry) {
+        if (cache.Contains(entry.crc, entry.size))
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (downloading == entry.Url)
+                return;
+            if (failed == entry.Url)
+                failed.clear();
+            prefetch = entry;
+            hasPrefetch = true;
+        }
+        condition.notify_all();
+    }
+
+    bool Library::Fetch(const Entry &entry, std::vector<uint8_t> &data) {
+        if (cache.Get(entry.crc, entry.size, data))
+            return true;
+
+        {
+            // the prefetch for the rom is already running
+            std::unique_lock<std::mutex> lock(mutex);
+            if (hasPrefetch && prefetch.Url == entry.Url)
+                hasPrefetch = false;
+            condition.wait(lock, [&] { return downloading != entry.Url; });
+        }
+
+        if (cache.Get(entry.crc, entry.size, data))
+            return true;
+
+        if (!Download(entry, data, false))
+            return false;
+        cache.Put(entry.crc, data);
+        return true;
+    }
+
+    Library::Status Library::GetStatus(const Entry &entry, uint32_t &bytes) {
+        bytes = 0;
+        if (cache.Contains(entry.crc, entry.size))
+            return StatusCached;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (downloading == entry.Url) {
+            bytes = downloadedBytes;
+            return StatusDownloading;
+        }
+        if (hasPrefetch && prefetch.Url == entry.Url)
+            return StatusDownloading;
+        return failed == entry.Url ? StatusFailed : StatusMissing;
+    }
+
+    bool Library::Download(const Entry &entry, std::vector<uint8_t> &data, bool reportProgress) {
+        if (entry.size == 0 || entry.size > MAX_ROM_SIZE)
+            return false;
+
+        std::vector<uint8_t> chunk;
+        for (uint32_t offset = 0; offset < entry.size;) {
+            uint32_t length = std::min(CHUNK_SIZE, entry.size - offset);
+            // a failed chunk gets requested again instead of starting over
+            bool received = false;
+            uint64_t resourceSize = 0;
+            for (int retry = 0; retry < MAX_RETRIES && !received; ++retry)
+                received = HttpGet(entry.Url, offset, length, chunk, &resourceSize);
+            if (!received)
+                return false;
+
+            // the file on the server has to be the one from the manifest before the buffer for it gets allocated
+            if (resourceSize != 0 && resourceSize != entry.size)
+                return false;
+            if (offset == 0)
+                data.resize(entry.size);
+
+            memcpy(data.data() + offset, chunk.data(), length);
+            offset += length;
+
+            if (reportProgress) {
+                std::lock_guard<std::mutex> lock(mutex);
+                downloadedBytes = offset;
+            }
+        }
+
+        return crc32(0, data.data(), (uInt) data.size()) == entry.crc;
+    }
+
+    void Library::WorkerThread() {
+        std::vector<uint8_t> manifest;
+        if (HttpGet(manifestUrl, 0, 0, manifest)) {
+            std::string text(manifest.begin(), manifest.end());
+            // a crash while writing must not leave half a manifest behind for the next start
+            if (UseManifest(text)) {
+                std::string tempPath = manifestCachePath + ".tmp";
+                std::ofstream file(tempPath, std::ios::trunc);
+                file << text;
+                file.close();
+                if (file.fail() || rename(tempPath.c_str(), manifestCachePath.c_str()) != 0)
+                    remove(tempPath.c_str());
+            }
+        }
+
+        while (true) {
+            Entry entry;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || hasPrefetch; });
+                if (stopping)
+                    return;
+
+                entry = prefetch;
+                hasPrefetch = false;
+                downloading = entry.Url;
+                downloadedBytes = 0;
+            }
+
+            std::vector<uint8_t> data;
+            bool cached = cache.Contains(entry.crc, entry.size);
+            if (!cached && Download(entry, data, true)) {
+                cache.Put(entry.crc, data);
+                cached = true;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!cached)
+                    failed = entry.Url;
+                downloading.clear();
+            }
+            condition.notify_all();
+        }
+    }
+
+}  // namespace RemoteLibrary
@@ -0,0 +1,99 @@
+#ifndef VB_REMOTE_LIBRARY_H
+#define VB_REMOTE_LIBRARY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RomCache.h"
+
+// Rom library served over http. The manifest lists one rom per line:
+//     <crc32 in hex> <size in bytes> <path relative to the manifest>
+// Roms get downloaded in chunks with range requests, checked against their crc and stored in
+// the rom cache, so every rom only gets downloaded once as long as it stays in the cache.
+// vblibrary (LibraryMain.cpp) runs the library against a throttled local server.
+namespace RemoteLibrary {
+
+    // bigger than any virtual boy rom, the manifest and the server do not get to decide how much gets allocated
+    const uint32_t MAX_ROM_SIZE = 16 * 1024 * 1024;
+
+    struct Entry {
+        std::string Name;
+        std::string Url;
+        uint32_t crc;
+        uint32_t size;
+    };
+
+    bool IsRemote(const std::string &path);
+
+    bool ParseManifest(const std::string &text, const std::string &manifestUrl, std::vector<Entry> &entries);
+
+    // rangeLength 0 requests the whole resource; resourceSize gets the size of the whole resource the
+    // server reported in Content-Range or Content-Length, 0 if it did not report one
+    bool HttpGet(const std::string &url, uint32_t rangeStart, uint32_t rangeLength, std::vector<uint8_t> &body,
+                 uint64_t *resourceSize = nullptr);
+
+    class Library {
+    public:
+        explicit Library(RomCache &cache);
+
+        ~Library();
+
+        // the cached manifest is available right away, the server gets asked for a new one in the background
+        void Open(const std::string &manifestUrl, const std::string &manifestCachePath);
+
+        // entries of a manifest that was read since the last call
+        bool TakeEntries(std::vector<Entry> &entries);
+
+        bool Find(const std::string &url, Entry &entry);
+
+        // downloads the rom in the background, replaces the previous prefetch if it did not start yet
+        void Prefetch(const Entry &entry);
+
+        // returns the cached rom, waits for a running download of it or downloads it
+        bool Fetch(const Entry &entry, std::vector<uint8_t> &data);
+
+        enum Status {
+            StatusMissing,
+            StatusDownloading,
+            StatusCached,
+            StatusFailed
+        };
+
+        // state of the background download of the rom, downloadedBytes gets set while it is downloading
+        Status GetStatus(const Entry &entry, uint32_t &downloadedBytes);
+
+    private:
+        void WorkerThread();
+
+        bool Download(const Entry &entry, std::vector<uint8_t> &data, bool reportProgress);
+
+        bool UseManifest(const std::string &text);
+
+        RomCache &cache;
+        std::string manifestUrl;
+        std::string manifestCachePath;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::thread worker;
+        bool stopping = false;
+
+        std::vector<Entry> entries;
+        bool entriesChanged = false;
+
+        bool hasPrefetch = false;
+        Entry prefetch;
+        // url of the download the worker is running
+        std::string downloading;
+        uint32_t downloadedBytes = 0;
+        // url of the last download of the worker that did not work out
+        std::string failed;
+    };
+
+}  // namespace RemoteLibrary
+
+#endif
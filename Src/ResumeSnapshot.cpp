@@ -0,0 +1,131 @@
+#include "ResumeSnapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+namespace ResumeSnapshot {
+
+    const uint32_t SNAPSHOT_MAGIC = 0x53525656;  // "VVRS"
+    const uint32_t SNAPSHOT_VERSION = 3;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t romSize;
+        uint32_t stateSize;
+        uint32_t frameSize;
+        uint32_t payloadSize;
+        uint32_t compressedSize;
+        uint32_t crc;
+    };
+
+    void WriteString(std::vector<uint8_t> &payload, const std::string &str) {
+        uint32_t length = (uint32_t) str.size();
+        payload.insert(payload.end(), (const uint8_t *) &length, (const uint8_t *) &length + sizeof(uint32_t));
+        payload.insert(payload.end(), str.begin(), str.end());
+    }
+
+    bool ReadString(const std::vector<uint8_t> &payload, size_t &offset, std::string &str) {
+        uint32_t length;
+        if (offset + sizeof(uint32_t) > payload.size())
+            return false;
+        memcpy(&length, &payload[offset], sizeof(uint32_t));
+        offset += sizeof(uint32_t);
+
+        if (offset + length > payload.size())
+            return false;
+        str.assign((const char *) &payload[offset], length);
+        offset += length;
+        return true;
+    }
+
+    bool Write(const std::string &path, const Snapshot &snapshot) {
+        std::vector<uint8_t> payload;
+        payload.reserve(snapshot.Rom.size() + snapshot.State.size() + snapshot.Frame.size() + 1024);
+        WriteString(payload, snapshot.RomName);
+        WriteString(payload, snapshot.FullPath);
+        WriteString(payload, snapshot.FullPathNorm);
+        WriteString(payload, snapshot.SavePath);
+        WriteString(payload, snapshot.ArchiveEntry);
+        WriteString(payload, snapshot.PatchPath);
+        payload.insert(payload.end(), snapshot.Rom.begin(), snapshot.Rom.end());
+        payload.insert(payload.end(), snapshot.State.begin(), snapshot.State.end());
+        payload.insert(payload.end(), snapshot.Frame.begin(), snapshot.Frame.end());
+
+        uLongf compressedSize = compressBound(payload.size());
+        std::vector<uint8_t> compressed(compressedSize);
+        // speed matters more than size here, the app is about to go away
+        if (compress2(compressed.data(), &compressedSize, payload.data(), payload.size(), Z_BEST_SPEED) != Z_OK)
+            return false;
+
+        Header header;
+        header.magic = SNAPSHOT_MAGIC;
+        header.version = SNAPSHOT_VERSION;
+        header.romSize = (uint32_t) snapshot.Rom.size();
+        header.stateSize = (uint32_t) snapshot.State.size();
+        header.frameSize = (uint32_t) snapshot.Frame.size();
+        header.payloadSize = (uint32_t) payload.size();
+        header.compressedSize = (uint32_t) compressedSize;
+        header.crc = (uint32_t) crc32(0, payload.data(), payload.size());
+
+        // write to a temporary file first so a crash while writing can not leave a broken snapshot behind
+        std::string tempPath = path + ".tmp";
+        std::ofstream outfile(tempPath, std::ios::trunc | std::ios::binary);
+        outfile.write((const char *) &header, sizeof(Header));
+        outfile.write((const char *) compressed.data(), compressedSize);
+        outfile.close();
+        if (!outfile)
+            return false;
+
+        return rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+    bool Read(const std::string &path, Snapshot &snapshot) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+
+        long fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        Header header;
+        if (fileSize < (long) sizeof(Header) || !file.read((char *) &header, sizeof(Header)))
+            return false;
+        if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+            header.compressedSize != fileSize - sizeof(Header))
+            return false;
+
+        std::vector<uint8_t> compressed(header.compressedSize);
+        if (!file.read((char *) compressed.data(), header.compressedSize))
+            return false;
+        file.close();
+
+        std::vector<uint8_t> payload(header.payloadSize);
+        uLongf payloadSize = header.payloadSize;
+        if (uncompress(payload.data(), &payloadSize, compressed.data(), compressed.size()) != Z_OK ||
+            payloadSize != header.payloadSize)
+            return false;
+        if (crc32(0, payload.data(), payload.size()) != header.crc)
+            return false;
+
+        size_t offset = 0;
+        if (!ReadString(payload, offset, snapshot.RomName) || !ReadString(payload, offset, snapshot.FullPath) ||
+            !ReadString(payload, offset, snapshot.FullPathNorm) || !ReadString(payload, offset, snapshot.SavePath) ||
+            !ReadString(payload, offset, snapshot.ArchiveEntry) || !ReadString(payload, offset, snapshot.PatchPath))
+            return false;
+        if (offset + header.romSize + header.stateSize + header.frameSize != payload.size())
+            return false;
+
+        std::vector<uint8_t>::const_iterator data = payload.begin() + offset;
+        snapshot.Rom.assign(data, data + header.romSize);
+        data += header.romSize;
+        snapshot.State.assign(data, data + header.stateSize);
+        data += header.stateSize;
+        snapshot.Frame.assign(data, data + header.frameSize);
+
+        return true;
+    }
+
+}  // namespace ResumeSnapshot
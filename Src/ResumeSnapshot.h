@@ -0,0 +1,34 @@
+#ifndef VB_RESUME_SNAPSHOT_H
+#define VB_RESUME_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Snapshot of the running game that gets written when the app gets suspended.
+// It holds everything needed to continue without going through the menu: the rom,
+// the core state and the last frame so it can get shown before the core produced one.
+namespace ResumeSnapshot {
+
+    struct Snapshot {
+        std::string RomName;
+        std::string FullPath;
+        std::string FullPathNorm;
+        std::string SavePath;
+        std::string ArchiveEntry;
+        std::string PatchPath;
+
+        std::vector<uint8_t> Rom;
+        std::vector<uint8_t> State;
+        std::vector<uint8_t> Frame;
+    };
+
+    // compresses the snapshot and replaces the file at path
+    bool Write(const std::string &path, const Snapshot &snapshot);
+
+    // reads and validates the snapshot, returns false if it is missing or broken
+    bool Read(const std::string &path, Snapshot &snapshot);
+
+}  // namespace ResumeSnapshot
+
+#endif
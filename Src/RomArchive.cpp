@@ -0,0 +1,195 @@
+#include "RomArchive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+namespace RomArchive {
+
+    namespace {
+        const uint32_t END_OF_DIRECTORY_MAGIC = 0x06054b50;
+        const uint32_t DIRECTORY_ENTRY_MAGIC = 0x02014b50;
+        const uint32_t LOCAL_HEADER_MAGIC = 0x04034b50;
+
+        const size_t END_OF_DIRECTORY_SIZE = 22;
+        const size_t DIRECTORY_ENTRY_SIZE = 46;
+        const size_t LOCAL_HEADER_SIZE = 30;
+        const size_t MAX_COMMENT_SIZE = 0xFFFF;
+
+        const uint16_t METHOD_STORED = 0;
+        const uint16_t METHOD_DEFLATED = 8;
+
+        const size_t CHUNK_SIZE = 64 * 1024;
+
+        // zip headers are little endian and not aligned
+        uint16_t Read16(const uint8_t *data) {
+            return (uint16_t) (data[0] | (data[1] << 8));
+        }
+
+        uint32_t Read32(const uint8_t *data) {
+            return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+        }
+
+        bool ReadAt(FILE *file, long offset, uint8_t *data, size_t size) {
+            return fseek(file, offset, SEEK_SET) == 0 && fread(data, 1, size, file) == size;
+        }
+
+        bool Inflate(FILE *file, const Entry &entry, std::vector<uint8_t> &data) {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            // raw deflate stream without zlib header
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+                return false;
+
+            std::vector<uint8_t> chunk(CHUNK_SIZE);
+            stream.next_out = data.data();
+            stream.avail_out = (uInt) data.size();
+
+            uint32_t remaining = entry.compressedSize;
+            int result = Z_OK;
+            while (result == Z_OK) {
+                if (stream.avail_in == 0) {
+                    size_t readSize = std::min((size_t) remaining, chunk.size());
+                    if (readSize == 0 || fread(chunk.data(), 1, readSize, file) != readSize)
+                        break;
+                    remaining -= readSize;
+                    stream.next_in = chunk.data();
+                    stream.avail_in = (uInt) readSize;
+                }
+                result = inflate(&stream, Z_NO_FLUSH);
+            }
+
+            bool success = result == Z_STREAM_END && stream.total_out == data.size();
+            inflateEnd(&stream);
+            return success;
+        }
+    }
+
+    bool IsArchive(const std::string &path) {
+        if (path.size() < 4)
+            return false;
+
+        std::string extension = path.substr(path.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".zip";
+    }
+
+    bool ReadIndex(const std::string &path, std::vector<Entry> &entries) {
+        entries.clear();
+
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+
+        // the end of directory record is at the end of the file, followed by an optional comment
+        size_t tailSize = (size_t) std::min((long) (END_OF_DIRECTORY_SIZE + MAX_COMMENT_SIZE), fileSize);
+        std::vector<uint8_t> tail(tailSize);
+        if (tailSize < END_OF_DIRECTORY_SIZE || !ReadAt(file, fileSize - (long) tailSize, tail.data(), tailSize)) {
+            fclose(file);
+            return false;
+        }
+
+        long endOffset = -1;
+        for (long i = (long) (tailSize - END_OF_DIRECTORY_SIZE); i >= 0; --i) {
+            if (Read32(&tail[i]) == END_OF_DIRECTORY_MAGIC) {
+                endOffset = i;
+                break;
+            }
+        }
+        if (endOffset < 0) {
+            fclose(file);
+            return false;
+        }
+
+        const uint8_t *end = &tail[endOffset];
+        uint16_t entryCount = Read16(end + 10);
+        uint32_t directorySize = Read32(end + 12);
+        uint32_t directoryOffset = Read32(end + 16);
+        if ((long) directoryOffset + (long) directorySize > fileSize) {
+            fclose(file);
+            return false;
+        }
+
+        std::vector<uint8_t> directory(directorySize);
+        bool success = ReadAt(file, directoryOffset, directory.data(), directorySize);
+        fclose(file);
+        if (!success)
+            return false;
+
+        size_t offset = 0;
+        for (int i = 0; i < entryCount; ++i) {
+            if (offset + DIRECTORY_ENTRY_SIZE > directory.size())
+                return false;
+
+            const uint8_t *header = &directory[offset];
+            if (Read32(header) != DIRECTORY_ENTRY_MAGIC)
+                return false;
+
+            uint16_t nameLength = Read16(header + 28);
+            uint16_t extraLength = Read16(header + 30);
+            uint16_t commentLength = Read16(header + 32);
+            if (offset + DIRECTORY_ENTRY_SIZE + nameLength > directory.size())
+                return false;
+
+            Entry entry;
+            entry.method = Read16(header + 10);
+            entry.crc = Read32(header + 16);
+            entry.compressedSize = Read32(header + 20);
+            entry.size = Read32(header + 24);
+            entry.localHeaderOffset = Read32(header + 42);
+            entry.Name.assign((const char *) header + DIRECTORY_ENTRY_SIZE, nameLength);
+
+            // folders and entries that can not be extracted are left out
+            bool encrypted = (Read16(header + 8) & 1) != 0;
+            if (!encrypted && entry.size > 0 && (entry.method == METHOD_STORED || entry.method == METHOD_DEFLATED))
+                entries.push_back(entry);
+
+            offset += DIRECTORY_ENTRY_SIZE + nameLength + extraLength + commentLength;
+        }
+
+        return true;
+    }
+
+    bool FindEntry(const std::string &path, const std::string &name, Entry &entry) {
+        std::vector<Entry> entries;
+        if (!ReadIndex(path, entries))
+            return false;
+
+        for (const Entry &current : entries) {
+            if (current.Name == name) {
+                entry = current;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Extract(const std::string &path, const Entry &entry, std::vector<uint8_t> &data) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        // the local header can have a different extra field than the directory entry
+        uint8_t header[LOCAL_HEADER_SIZE];
+        if (!ReadAt(file, entry.localHeaderOffset, header, LOCAL_HEADER_SIZE) || Read32(header) != LOCAL_HEADER_MAGIC) {
+            fclose(file);
+            return false;
+        }
+        long dataOffset = (long) entry.localHeaderOffset + LOCAL_HEADER_SIZE + Read16(header + 26) + Read16(header + 28);
+
+        data.resize(entry.size);
+        bool success = fseek(file, dataOffset, SEEK_SET) == 0;
+        if (success && entry.method == METHOD_STORED)
+            success = entry.compressedSize == entry.size && fread(data.data(), 1, data.size(), file) == data.size();
+        else if (success)
+            success = Inflate(file, entry, data);
+        fclose(file);
+
+        return success && crc32(0, data.data(), (uInt) data.size()) == entry.crc;
+    }
+
+}  // namespace RomArchive
@@ -0,0 +1,33 @@
+#ifndef VB_ROM_ARCHIVE_H
+#define VB_ROM_ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reads roms out of zip archives. Listing only parses the central directory at the end of the
+// file; extracting inflates the entry in chunks straight into the output buffer.
+// Stored and deflated entries are supported, zip64 and encrypted entries are not.
+namespace RomArchive {
+
+    struct Entry {
+        std::string Name;
+        uint16_t method;
+        uint32_t crc;
+        uint32_t compressedSize;
+        uint32_t size;
+        uint32_t localHeaderOffset;
+    };
+
+    bool IsArchive(const std::string &path);
+
+    bool ReadIndex(const std::string &path, std::vector<Entry> &entries);
+
+    bool FindEntry(const std::string &path, const std::string &name, Entry &entry);
+
+    // extracts the entry and checks its crc
+    bool Extract(const std::string &path, const Entry &entry, std::vector<uint8_t> &data);
+
+}  // namespace RomArchive
+
+#endif
@@ -0,0 +1,133 @@
+#include "RomCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <zlib.h>
+
+void RomCache::Init(const std::string &folder, uint64_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->folder = folder;
+    this->maxBytes = maxBytes;
+    mkdir(folder.c_str(), 0755);
+    Trim();
+}
+
+std::string RomCache::FilePath(uint32_t crc, uint32_t size) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%08x_%u.rom", crc, size);
+    return folder + name;
+}
+
+bool RomCache::Get(uint32_t crc, uint32_t size, std::vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (folder.empty())
+        return false;
+
+    std::string path = FilePath(crc, size);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    data.resize(size);
+    bool success = fread(data.data(), 1, size, file) == size;
+    fclose(file);
+
+    if (!success || crc32(0, data.data(), (uInt) size) != crc) {
+        remove(path.c_str());
+        return false;
+    }
+
+    // the modification time is used as the last access time
+    utime(path.c_str(), nullptr);
+    return true;
+}
+
+void RomCache::Put(uint32_t crc, const std::vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (folder.empty() || data.size() > maxBytes)
+        return;
+
+    std::string path = FilePath(crc, (uint32_t) data.size());
+    std::string tempPath = path + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return;
+
+    bool success = fwrite(data.data(), 1, data.size(), file) == data.size();
+    success = fclose(file) == 0 && success;
+    if (success && rename(tempPath.c_str(), path.c_str()) == 0)
+        Trim();
+    else
+        remove(tempPath.c_str());
+}
+
+bool RomCache::Contains(uint32_t crc, uint32_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    struct stat info;
+    return !folder.empty() && stat(FilePath(crc, size).c_str(), &info) == 0 && (uint32_t) info.st_size == size;
+}
+
+std::string RomCache::AliasPath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.alias", (unsigned long long) key);
+    return folder + name;
+}
+
+void RomCache::PutAlias(uint64_t key, uint32_t crc, uint32_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (folder.empty())
+        return;
+
+    FILE *file = fopen(AliasPath(key).c_str(), "w");
+    if (!file)
+        return;
+    fprintf(file, "%08x %u\n", crc, size);
+    fclose(file);
+}
+
+bool RomCache::GetAlias(uint64_t key, uint32_t &crc, uint32_t &size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (folder.empty())
+        return false;
+
+    FILE *file = fopen(AliasPath(key).c_str(), "r");
+    if (!file)
+        return false;
+    bool success = fscanf(file, "%x %u", &crc, &size) == 2;
+    fclose(file);
+    return success;
+}
+
+void RomCache::Trim() {
+    DIR *dir = opendir(folder.c_str());
+    if (!dir)
+        return;
+
+    struct CachedFile {
+        std::string path;
+        time_t lastUse;
+        uint64_t size;
+    };
+    std::vector<CachedFile> files;
+    uint64_t totalSize = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string path = folder + entry->d_name;
+        struct stat info;
+        if (entry->d_name[0] == '.' || stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            continue;
+        files.push_back({path, info.st_mtime, (uint64_t) info.st_size});
+        totalSize += info.st_size;
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end(), [](const CachedFile &a, const CachedFile &b) { return a.lastUse < b.lastUse; });
+    for (size_t i = 0; i < files.size() && totalSize > maxBytes; ++i) {
+        remove(files[i].path.c_str());
+        totalSize -= files[i].size;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef VB_ROM_CACHE_H
+#define VB_ROM_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Folder of roms that had to be extracted or downloaded before they could be used, keyed by
+// the crc and size of their content. The least recently used files get deleted once the
+// folder grows past its size limit.
+class RomCache {
+public:
+    void Init(const std::string &folder, uint64_t maxBytes);
+
+    // reads the cached rom and checks its crc
+    bool Get(uint32_t crc, uint32_t size, std::vector<uint8_t> &data);
+
+    void Put(uint32_t crc, const std::vector<uint8_t> &data);
+
+    bool Contains(uint32_t crc, uint32_t size);
+
+    // roms that are made from other files, like patched roms, get found through a key of their inputs
+    void PutAlias(uint64_t key, uint32_t crc, uint32_t size);
+
+    bool GetAlias(uint64_t key, uint32_t &crc, uint32_t &size);
+
+private:
+    std::string FilePath(uint32_t crc, uint32_t size) const;
+
+    std::string AliasPath(uint64_t key) const;
+
+    void Trim();
+
+    std::mutex mutex;
+    std::string folder;
+    uint64_t maxBytes = 0;
+};
+
+#endif
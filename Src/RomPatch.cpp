@@ -0,0 +1,276 @@
+#include "RomPatch.h"
+
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+namespace RomPatch {
+
+    namespace {
+        const char IPS_MAGIC[] = "PATCH";
+        const char IPS_END[] = "EOF";
+        const char BPS_MAGIC[] = "BPS1";
+        // source, target and patch crc
+        const size_t BPS_FOOTER_SIZE = 12;
+        // nothing bigger than this makes sense for a virtual boy rom
+        const uint64_t MAX_TARGET_SIZE = 16 * 1024 * 1024;
+
+        // reads the patch front to back through a fixed buffer
+        class Stream {
+        public:
+            explicit Stream(const std::string &path) {
+                file = fopen(path.c_str(), "rb");
+                if (file) {
+                    fseek(file, 0, SEEK_END);
+                    size = (uint64_t) ftell(file);
+                    fseek(file, 0, SEEK_SET);
+                }
+            }
+
+            ~Stream() {
+                if (file)
+                    fclose(file);
+            }
+
+            bool IsOpen() const { return file != nullptr; }
+
+            uint64_t Size() const { return size; }
+
+            uint64_t Offset() const { return offset; }
+
+            bool Read(uint8_t *data, size_t length) {
+                while (length > 0) {
+                    if (bufferPosition == bufferFill && !Fill())
+                        return false;
+
+                    size_t count = bufferFill - bufferPosition;
+                    if (count > length)
+                        count = length;
+                    memcpy(data, buffer + bufferPosition, count);
+                    bufferPosition += count;
+                    offset += count;
+                    data += count;
+                    length -= count;
+                }
+                return true;
+            }
+
+            bool ReadByte(uint8_t &value) { return Read(&value, 1); }
+
+            // big endian numbers in ips patches
+            bool ReadBigEndian(uint32_t &value, int bytes) {
+                uint8_t data[4];
+                if (!Read(data, (size_t) bytes))
+                    return false;
+
+                value = 0;
+                for (int i = 0; i < bytes; ++i)
+                    value = (value << 8) | data[i];
+                return true;
+            }
+
+            // variable length numbers in bps patches
+            bool ReadNumber(uint64_t &value) {
+                value = 0;
+                uint64_t shift = 1;
+                for (int i = 0; i < 10; ++i) {
+                    uint8_t data;
+                    if (!ReadByte(data))
+                        return false;
+
+                    value += (data & 0x7F) * shift;
+                    if (data & 0x80)
+                        return true;
+                    shift <<= 7;
+                    value += shift;
+                }
+                return false;
+            }
+
+        private:
+            bool Fill() {
+                bufferPosition = 0;
+                bufferFill = fread(buffer, 1, sizeof(buffer), file);
+                return bufferFill > 0;
+            }
+
+            FILE *file;
+            uint64_t size = 0;
+            uint64_t offset = 0;
+            uint8_t buffer[16 * 1024];
+            size_t bufferPosition = 0;
+            size_t bufferFill = 0;
+        };
+
+        bool ApplyIps(Stream &patch, std::vector<uint8_t> &rom) {
+            uint8_t magic[5];
+            if (!patch.Read(magic, sizeof(magic)) || memcmp(magic, IPS_MAGIC, sizeof(magic)) != 0)
+                return false;
+
+            while (true) {
+                uint8_t record[3];
+                if (!patch.Read(record, sizeof(record)))
+                    return false;
+                if (memcmp(record, IPS_END, sizeof(record)) == 0)
+                    break;
+
+                uint32_t offset = ((uint32_t) record[0] << 16) | ((uint32_t) record[1] << 8) | record[2];
+                uint32_t length;
+                if (!patch.ReadBigEndian(length, 2))
+                    return false;
+
+                // run length encoded record
+                uint8_t value = 0;
+                bool repeat = length == 0;
+                if (repeat && (!patch.ReadBigEndian(length, 2) || !patch.ReadByte(value)))
+                    return false;
+
+                if (offset + length > rom.size())
+                    rom.resize(offset + length, 0);
+
+                if (repeat)
+                    memset(rom.data() + offset, value, length);
+                else if (!patch.Read(rom.data() + offset, length))
+                    return false;
+            }
+
+            // optional size the rom gets truncated to
+            uint32_t truncateSize;
+            if (patch.Offset() + 3 <= patch.Size() && patch.ReadBigEndian(truncateSize, 3) && truncateSize < rom.size())
+                rom.resize(truncateSize);
+            return true;
+        }
+
+        bool ApplyBps(Stream &patch, std::vector<uint8_t> &rom, std::vector<uint8_t> &scratch) {
+            uint8_t magic[4];
+            if (patch.Size() < sizeof(magic) + BPS_FOOTER_SIZE ||
+                !patch.Read(magic, sizeof(magic)) || memcmp(magic, BPS_MAGIC, sizeof(magic)) != 0)
+                return false;
+
+            uint64_t sourceSize, targetSize, metadataSize;
+            if (!patch.ReadNumber(sourceSize) || !patch.ReadNumber(targetSize) || !patch.ReadNumber(metadataSize))
+                return false;
+            if (sourceSize != rom.size() || targetSize > MAX_TARGET_SIZE)
+                return false;
+
+            // the metadata is not needed
+            uint8_t skip[256];
+            while (metadataSize > 0) {
+                size_t length = metadataSize < sizeof(skip) ? (size_t) metadataSize : sizeof(skip);
+                if (!patch.Read(skip, length))
+                    return false;
+                metadataSize -= length;
+            }
+
+            std::vector<uint8_t> &target = scratch;
+            target.resize((size_t) targetSize);
+
+            uint64_t outputOffset = 0;
+            int64_t sourceOffset = 0;
+            int64_t targetOffset = 0;
+            uint64_t actionsEnd = patch.Size() - BPS_FOOTER_SIZE;
+
+            while (patch.Offset() < actionsEnd) {
+                uint64_t data;
+                if (!patch.ReadNumber(data))
+                    return false;
+
+                uint64_t command = data & 3;
+                uint64_t length = (data >> 2) + 1;
+                if (outputOffset + length > targetSize)
+                    return false;
+
+                if (command == 0) {
+                    // source read
+                    if (outputOffset + length > sourceSize)
+                        return false;
+                    memcpy(target.data() + outputOffset, rom.data() + outputOffset, (size_t) length);
+                } else if (command == 1) {
+                    // target read
+                    if (!patch.Read(target.data() + outputOffset, (size_t) length))
+                        return false;
+                } else {
+                    uint64_t relative;
+                    if (!patch.ReadNumber(relative))
+                        return false;
+
+                    int64_t &copyOffset = command == 2 ? sourceOffset : targetOffset;
+                    copyOffset += (relative & 1 ? -1 : 1) * (int64_t) (relative >> 1);
+
+                    if (command == 2) {
+                        // source copy
+                        if (copyOffset < 0 || (uint64_t) copyOffset + length > sourceSize)
+                            return false;
+                        memcpy(target.data() + outputOffset, rom.data() + copyOffset, (size_t) length);
+                    } else {
+                        // target copy, the ranges can overlap to repeat a pattern so it has to go byte by byte
+                        if (copyOffset < 0 || (uint64_t) copyOffset >= outputOffset)
+                            return false;
+                        for (uint64_t i = 0; i < length; ++i)
+                            target[outputOffset + i] = target[copyOffset + i];
+                    }
+                    copyOffset += length;
+                }
+                outputOffset += length;
+            }
+
+            uint32_t footer[3];
+            if (outputOffset != targetSize || !patch.Read((uint8_t *) footer, sizeof(footer)))
+                return false;
+
+            // the footer is little endian like the device
+            if (crc32(0, rom.data(), (uInt) rom.size()) != footer[0] ||
+                crc32(0, target.data(), (uInt) target.size()) != footer[1])
+                return false;
+
+            rom.swap(target);
+            return true;
+        }
+    }
+
+    Format Detect(const std::string &path) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return FormatNone;
+
+        char magic[5] = {};
+        size_t length = fread(magic, 1, sizeof(magic), file);
+        fclose(file);
+
+        if (length == sizeof(magic) && memcmp(magic, IPS_MAGIC, 5) == 0)
+            return FormatIps;
+        if (length >= 4 && memcmp(magic, BPS_MAGIC, 4) == 0)
+            return FormatBps;
+        return FormatNone;
+    }
+
+    bool Checksum(const std::string &path, uint32_t &crc) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        uint8_t buffer[16 * 1024];
+        size_t length;
+        crc = 0;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            crc = (uint32_t) crc32(crc, buffer, (uInt) length);
+
+        bool success = !ferror(file);
+        fclose(file);
+        return success;
+    }
+
+    bool Apply(const std::string &path, std::vector<uint8_t> &rom, std::vector<uint8_t> &scratch) {
+        Format format = Detect(path);
+        Stream patch(path);
+        if (!patch.IsOpen())
+            return false;
+
+        if (format == FormatIps)
+            return ApplyIps(patch, rom);
+        if (format == FormatBps)
+            return ApplyBps(patch, rom, scratch);
+        return false;
+    }
+
+}  // namespace RomPatch
@@ -0,0 +1,29 @@
+#ifndef VB_ROM_PATCH_H
+#define VB_ROM_PATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Soft patching of roms with ips or bps patches. The patch file gets streamed through a small
+// buffer instead of being loaded, ips patches get applied in place.
+namespace RomPatch {
+
+    enum Format {
+        FormatNone = 0,
+        FormatIps,
+        FormatBps
+    };
+
+    // looks at the magic of the file
+    Format Detect(const std::string &path);
+
+    // crc32 of the whole patch file
+    bool Checksum(const std::string &path, uint32_t &crc);
+
+    // replaces rom with the patched rom, bps patches write into scratch and swap it with rom
+    bool Apply(const std::string &path, std::vector<uint8_t> &rom, std::vector<uint8_t> &scratch);
+
+}  // namespace RomPatch
+
+#endif
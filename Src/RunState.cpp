@@ -0,0 +1,67 @@
+#include "RunState.h"
+
+#include <cstring>
+
+namespace RunState {
+
+    State Decide(bool background, bool headsetMounted, bool menuOpen) {
+        if (background)
+            return Background;
+        if (!headsetMounted)
+            return HeadsetOff;
+        if (menuOpen)
+            return MenuPaused;
+        return Playing;
+    }
+
+    void Reset(Tracker &tracker, double time) {
+        tracker.state = Playing;
+        tracker.stateStart = time;
+        ClearCounters(tracker, time);
+    }
+
+    bool Change(Tracker &tracker, State state, double time) {
+        if (state == tracker.state)
+            return false;
+
+        tracker.counters[tracker.state].seconds += time - tracker.stateStart;
+        tracker.state = state;
+        tracker.stateStart = time;
+        return true;
+    }
+
+    Counters &Current(Tracker &tracker) {
+        return tracker.counters[tracker.state];
+    }
+
+    bool ReportDue(Tracker &tracker, double time, double window) {
+        if (time - tracker.reportStart < window)
+            return false;
+
+        // the time of the running state goes into the window that ends now
+        tracker.counters[tracker.state].seconds += time - tracker.stateStart;
+        tracker.stateStart = time;
+        return true;
+    }
+
+    void ClearCounters(Tracker &tracker, double time) {
+        memset(tracker.counters, 0, sizeof(tracker.counters));
+        tracker.reportStart = time;
+    }
+
+    std::string Name(State state) {
+        switch (state) {
+            case Background:
+                return "background";
+            case HeadsetOff:
+                return "headset off";
+            case MenuPaused:
+                return "menu";
+            case Playing:
+                return "playing";
+            default:
+                return "unknown";
+        }
+    }
+
+}  // namespace RunState
@@ -0,0 +1,54 @@
+#ifndef VB_RUN_STATE_H
+#define VB_RUN_STATE_H
+
+#include <cstdint>
+#include <string>
+
+// What the app is doing right now. Everything but playing is an idle state where the core does
+// not run and nothing gets uploaded, the last frame stays on screen.
+namespace RunState {
+
+    // ordered by priority, the first one that applies wins
+    enum State {
+        Background = 0,
+        HeadsetOff,
+        MenuPaused,
+        Playing,
+        StateCount
+    };
+
+    // the work done in one state, used to see where the power goes
+    struct Counters {
+        double seconds;
+        uint32_t framesEmulated;
+        uint32_t framesUploaded;
+        uint64_t bytesUploaded;
+        uint32_t audioFrames;
+    };
+
+    struct Tracker {
+        State state;
+        double stateStart;
+        double reportStart;
+        Counters counters[StateCount];
+    };
+
+    State Decide(bool background, bool headsetMounted, bool menuOpen);
+
+    void Reset(Tracker &tracker, double time);
+
+    // returns true if the state changed
+    bool Change(Tracker &tracker, State state, double time);
+
+    Counters &Current(Tracker &tracker);
+
+    // returns true once the report window is over, the counters then hold the whole window
+    bool ReportDue(Tracker &tracker, double time, double window);
+
+    void ClearCounters(Tracker &tracker, double time);
+
+    std::string Name(State state);
+
+}  // namespace RunState
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef VB_SCREEN_LAYOUT_H
+#define VB_SCREEN_LAYOUT_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "EmulatorContext.h"
+
+// Converts the 8 bit frames of the core into the layouts the rest of the app works with: rgba images
+// for the screen textures and the slot images and the plain 8 bit eyes the captures and the frame
+// export store. Every layout is its own specialization so the per pixel loops do not branch on the
+// layout; the colors come from a 256 entry palette instead of being multiplied per pixel.
+// vbbatch has a "convert" job that times every layout.
+namespace ScreenLayout {
+
+    enum Layout {
+        // left eye on top of the right one with a transparent gap, used by the cylinder layer
+        Stacked,
+        // left eye only
+        Mono
+    };
+
+    // transparent rows between the eyes of the stacked layout
+    const int STACKED_BORDER = 1;
+
+    template<Layout layout>
+    struct Size;
+
+    template<>
+    struct Size<Stacked> {
+        static const int width = Emulator::VIDEO_WIDTH;
+        static const int height = Emulator::VIDEO_HEIGHT * 2 + STACKED_BORDER * 2;
+    };
+
+    template<>
+    struct Size<Mono> {
+        static const int width = Emulator::VIDEO_WIDTH;
+        static const int height = Emulator::VIDEO_HEIGHT;
+    };
+
+    // color is the rgb multiplier of the intensity, the result is in the byte order of GL_RGBA
+    inline void BuildPalette(const float color[3], uint32_t palette[256]) {
+        for (int i = 0; i < 256; ++i)
+            palette[i] = 0xFF000000 | ((uint32_t) (i * color[2]) << 16) | ((uint32_t) (i * color[1]) << 8) | (uint32_t) (i * color[0]);
+    }
+
+    inline void ConvertRow(const uint8_t *source, uint32_t *destination, const uint32_t *palette) {
+        for (int x = 0; x < Emulator::VIDEO_WIDTH; ++x)
+            destination[x] = palette[source[x]];
+    }
+
+    inline const uint8_t *LeftRow(const uint8_t *frame, int y) {
+        return frame + y * Emulator::VIDEO_WIDTH;
+    }
+
+    inline const uint8_t *RightRow(const uint8_t *frame, int y) {
+        return frame + Emulator::CORE_RIGHT_EYE_OFFSET + y * Emulator::VIDEO_WIDTH;
+    }
+
+    // 8 bit left eye followed by the right one without the gap the core leaves between them
+    inline void CopyEyes(const uint8_t *frame, uint8_t *output) {
+        const int eyeSize = Emulator::VIDEO_WIDTH * Emulator::VIDEO_HEIGHT;
+        memcpy(output, frame, eyeSize);
+        memcpy(output + eyeSize, frame + Emulator::CORE_RIGHT_EYE_OFFSET, eyeSize);
+    }
+
+    template<Layout layout>
+    void Convert(const uint8_t *frame, uint32_t *output, const uint32_t *palette);
+
+    template<>
+    inline void Convert<Stacked>(const uint8_t *frame, uint32_t *output, const uint32_t *palette) {
+        const int width = Size<Stacked>::width;
+        for (int y = 0; y < Emulator::VIDEO_HEIGHT; ++y)
+            ConvertRow(LeftRow(frame, y), output + y * width, palette);
+
+        memset(output + Emulator::VIDEO_HEIGHT * width, 0, STACKED_BORDER * 2 * width * sizeof(uint32_t));
+
+        uint32_t *right = output + (Emulator::VIDEO_HEIGHT + STACKED_BORDER * 2) * width;
+        for (int y = 0; y < Emulator::VIDEO_HEIGHT; ++y)
+            ConvertRow(RightRow(frame, y), right + y * width, palette);
+    }
+
+    template<>
+    inline void Convert<Mono>(const uint8_t *frame, uint32_t *output, const uint32_t *palette) {
+        const int width = Size<Mono>::width;
+        for (int y = 0; y < Emulator::VIDEO_HEIGHT; ++y)
+            ConvertRow(LeftRow(frame, y), output + y * width, palette);
+    }
+
+}  // namespace ScreenLayout
+
+#endif
@@ -0,0 +1,244 @@
+#include "StateFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace StateFile {
+
+    const uint32_t STATE_MAGIC = 0x53535656;  // "VVSS"
+    const uint32_t STATE_VERSION = 1;
+    const uint32_t INDEX_MAGIC = 0x49535656;  // "VVSI"
+    const uint32_t INDEX_VERSION = 2;
+    const size_t VERIFY_BUFFER_SIZE = 64 * 1024;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t coreVersion;
+        uint32_t stateSize;
+        uint32_t romHash;
+        uint32_t crc;
+    };
+
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t coreVersion;
+        uint32_t romHash;
+        uint32_t stateSize;
+        uint32_t slotCount;
+    };
+
+    // the size and modification time in nanoseconds of the file the status was found for, a state
+    // saved within the same second as the one that got checked still has to get checked again
+    struct IndexEntry {
+        int64_t fileSize;
+        int64_t fileTimeNanos;
+        uint32_t status;
+        uint32_t padding;
+    };
+
+    const char *Name(Status status) {
+        switch (status) {
+            case StatusMissing:
+                return "missing";
+            case StatusValid:
+                return "valid";
+            case StatusLegacy:
+                return "legacy";
+            case StatusMismatch:
+                return "mismatch";
+            case StatusBroken:
+                return "broken";
+        }
+        return "unknown";
+    }
+
+    // the rename is only durable once the directory entry got synced as well
+    bool SyncDirectory(const std::string &path) {
+        size_t separator = path.find_last_of('/');
+        std::string directory = separator == std::string::npos ? "." : separator == 0 ? "/" : path.substr(0, separator);
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+    }
+
+    // writes header and data to path + ".tmp" and replaces path with it; the data is synced before the rename
+    // so that a power loss can not leave a renamed but empty file behind
+    bool ReplaceFile(const std::string &path, const void *header, size_t headerSize, const void *data, size_t size) {
+        std::string tempPath = path + ".tmp";
+        FILE *file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+            return false;
+
+        bool written = fwrite(header, 1, headerSize, file) == headerSize && fwrite(data, 1, size, file) == size &&
+                       fflush(file) == 0 && fsync(fileno(file)) == 0;
+        written &= fclose(file) == 0;
+        if (!written) {
+            remove(tempPath.c_str());
+            return false;
+        }
+
+        return rename(tempPath.c_str(), path.c_str()) == 0 && SyncDirectory(path);
+    }
+
+    bool Write(const std::string &path, const Identity &identity, const uint8_t *state, size_t size) {
+        Header header;
+        header.magic = STATE_MAGIC;
+        header.version = STATE_VERSION;
+        header.coreVersion = identity.coreVersion;
+        header.stateSize = (uint32_t) size;
+        header.romHash = identity.romHash;
+        header.crc = (uint32_t) crc32(0, state, (uInt) size);
+
+        // a crash while writing only loses the temporary file and not the old state
+        return ReplaceFile(path, &header, sizeof(Header), state, size);
+    }
+
+    // reads the header and decides what the rest of the file has to look like, legacy states have no header
+    Status ReadHeader(std::ifstream &file, long fileSize, const Identity &identity, Header &header) {
+        if (fileSize >= (long) sizeof(Header) && file.read((char *) &header, sizeof(Header)) && header.magic == STATE_MAGIC) {
+            if (header.version != STATE_VERSION || header.stateSize != fileSize - sizeof(Header))
+                return StatusBroken;
+            if (header.coreVersion != identity.coreVersion || header.romHash != identity.romHash ||
+                header.stateSize != identity.stateSize)
+                return StatusMismatch;
+            return StatusValid;
+        }
+
+        file.clear();
+        file.seekg(0, std::ios::beg);
+        header = Header();
+        header.stateSize = (uint32_t) fileSize;
+        return fileSize == (long) identity.stateSize ? StatusLegacy : StatusBroken;
+    }
+
+    Status Read(const std::string &path, const Identity &identity, std::vector<uint8_t> &state) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return StatusMissing;
+
+        long fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        Header header;
+        Status status = ReadHeader(file, fileSize, identity, header);
+        if (!IsUsable(status))
+            return status;
+
+        state.resize(header.stateSize);
+        if (!file.read((char *) state.data(), header.stateSize))
+            return StatusBroken;
+        if (status == StatusValid && crc32(0, state.data(), (uInt) state.size()) != header.crc)
+            return StatusBroken;
+
+        return status;
+    }
+
+    Status Verify(const std::string &path, const Identity &identity, std::vector<uint8_t> &buffer) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return StatusMissing;
+
+        long fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        Header header;
+        Status status = ReadHeader(file, fileSize, identity, header);
+        if (status != StatusValid)
+            return status;
+
+        buffer.resize(VERIFY_BUFFER_SIZE);
+        uLong crc = crc32(0, Z_NULL, 0);
+        size_t remaining = header.stateSize;
+        while (remaining > 0) {
+            size_t chunk = remaining < buffer.size() ? remaining : buffer.size();
+            if (!file.read((char *) buffer.data(), chunk))
+                return StatusBroken;
+            crc = crc32(crc, buffer.data(), (uInt) chunk);
+            remaining -= chunk;
+        }
+
+        return (uint32_t) crc == header.crc ? StatusValid : StatusBroken;
+    }
+
+    bool ReadIndex(const std::string &path, const Identity &identity, size_t slotCount, std::vector<IndexEntry> &entries) {
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        long fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+        IndexHeader header;
+        if (!file.read((char *) &header, sizeof(IndexHeader)))
+            return false;
+        // everything has to get checked again once the core or the rom changed
+        if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION || header.coreVersion != identity.coreVersion ||
+            header.romHash != identity.romHash || header.stateSize != identity.stateSize)
+            return false;
+        // the slot count comes from the file, a broken one must not decide how much gets allocated
+        if (header.slotCount != slotCount || (size_t) fileSize != sizeof(IndexHeader) + slotCount * sizeof(IndexEntry))
+            return false;
+
+        entries.resize(header.slotCount);
+        return (bool) file.read((char *) entries.data(), entries.size() * sizeof(IndexEntry));
+    }
+
+    void WriteIndex(const std::string &path, const Identity &identity, const std::vector<IndexEntry> &entries) {
+        IndexHeader header;
+        header.magic = INDEX_MAGIC;
+        header.version = INDEX_VERSION;
+        header.coreVersion = identity.coreVersion;
+        header.romHash = identity.romHash;
+        header.stateSize = identity.stateSize;
+        header.slotCount = (uint32_t) entries.size();
+
+        ReplaceFile(path, &header, sizeof(IndexHeader), entries.data(), entries.size() * sizeof(IndexEntry));
+    }
+
+    void ValidateSlots(const std::vector<std::string> &slotPaths, const std::string &indexPath, const Identity &identity,
+                       std::vector<Status> &status, Stats &stats) {
+        std::vector<IndexEntry> index;
+        if (!ReadIndex(indexPath, identity, slotPaths.size(), index))
+            index.assign(slotPaths.size(), IndexEntry());
+
+        std::vector<uint8_t> buffer;
+        bool changed = false;
+        status.resize(slotPaths.size());
+        for (size_t i = 0; i < slotPaths.size(); ++i) {
+            struct stat info;
+            if (stat(slotPaths[i].c_str(), &info) != 0) {
+                status[i] = StatusMissing;
+                changed |= index[i].status != StatusMissing;
+                index[i] = IndexEntry();
+                continue;
+            }
+
+            IndexEntry &entry = index[i];
+            int64_t fileTimeNanos = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+            if (entry.status != StatusMissing && entry.fileSize == info.st_size && entry.fileTimeNanos == fileTimeNanos) {
+                status[i] = (Status) entry.status;
+                stats.fromIndex++;
+                continue;
+            }
+
+            status[i] = Verify(slotPaths[i], identity, buffer);
+            stats.verified++;
+            stats.bytesRead += (uint64_t) info.st_size;
+
+            entry.fileSize = info.st_size;
+            entry.fileTimeNanos = fileTimeNanos;
+            entry.status = status[i];
+            changed = true;
+        }
+
+        if (changed)
+            WriteIndex(indexPath, identity, index);
+    }
+
+}  // namespace StateFile
@@ -0,0 +1,57 @@
+#ifndef VB_STATE_FILE_H
+#define VB_STATE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Save state files with a header that ties the state to the core and the rom it was made with
+// and a crc of the state. States from before the header existed get accepted as long as their
+// size matches the current core. The index remembers which slots were already checked so the
+// menu knows about broken slots without reading every state again.
+namespace StateFile {
+
+    enum Status {
+        StatusMissing = 0,
+        StatusValid,
+        // headerless state of the right size, it can not get checked
+        StatusLegacy,
+        // made with another core version or another rom
+        StatusMismatch,
+        StatusBroken
+    };
+
+    // what a state has to match to get loaded
+    struct Identity {
+        uint32_t coreVersion;
+        uint32_t romHash;
+        uint32_t stateSize;
+    };
+
+    struct Stats {
+        uint32_t verified;
+        uint32_t fromIndex;
+        uint64_t bytesRead;
+    };
+
+    const char *Name(Status status);
+
+    inline bool IsUsable(Status status) { return status == StatusValid || status == StatusLegacy; }
+
+    // writes the state to a temporary file first and replaces the file at path with it
+    bool Write(const std::string &path, const Identity &identity, const uint8_t *state, size_t size);
+
+    // reads the state without the header, state only gets filled for usable states
+    Status Read(const std::string &path, const Identity &identity, std::vector<uint8_t> &state);
+
+    // checks the state without keeping it, the file gets streamed through buffer
+    Status Verify(const std::string &path, const Identity &identity, std::vector<uint8_t> &buffer);
+
+    // checks every slot; slots whose file did not change since the index at indexPath was written
+    // get their status from the index, the index gets rewritten if anything had to get checked
+    void ValidateSlots(const std::vector<std::string> &slotPaths, const std::string &indexPath, const Identity &identity,
+                       std::vector<Status> &status, Stats &stats);
+
+}  // namespace StateFile
+
+#endif
@@ -40,6 +40,10 @@ public class MainActivity extends VrActivity {
 
     public static native long nativeSetAppInterface(VrActivity act, String fromPackageNameString, String commandString, String uriString);
 
+    public static native void nativeSuspend();
+
+    public static native void nativeResume();
+
     @Override
     protected void onCreate(Bundle savedInstanceState) {
         super.onCreate(savedInstanceState);
@@ -63,6 +67,20 @@ public class MainActivity extends VrActivity {
         setAppPtr(nativeSetAppInterface(this, fromPackageNameString, commandString, uriString));
     }
 
+    @Override
+    protected void onPause() {
+        // write the resume snapshot while the game is still loaded
+        nativeSuspend();
+        super.onPause();
+    }
+
+    @Override
+    protected void onResume() {
+        super.onResume();
+        // the emulation continues with the next frame
+        nativeResume();
+    }
+
     public void StartApp() {
         CreateFolder();
     }